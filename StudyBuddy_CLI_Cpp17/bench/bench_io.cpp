@@ -0,0 +1,59 @@
+// Cost of replacing a data file, as compaction does for each CSV and snapshot.bin:
+// replace_file with and without fsync, over table sizes from a few rows to ~1 MiB.
+//
+//   make bench                      # writes into ./bench_data
+//   ./bench/bench_io <dir> [iters]  # measure on another filesystem
+//
+// Prints per-write latency (median, p99, mean) and throughput for each case.
+#include "file_io.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static std::string make_table(std::size_t bytes) {
+    std::string out;
+    out.reserve(bytes + 64);
+    for (int id = 1; out.size() < bytes; ++id) {
+        out += std::to_string(id) + ",Student " + std::to_string(id) + ",s" + std::to_string(id) + "@clemson.edu,\n";
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    fs::path dir = argc >= 2 ? argv[1] : "bench_data";
+    int iters = argc >= 3 ? std::max(1, std::atoi(argv[2])) : 50;
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    fs::path target = dir / "bench_table.csv";
+
+    std::printf("%-8s %-8s %12s %12s %12s %10s\n", "size", "mode", "median_us", "p99_us", "mean_us", "MB/s");
+    for (std::size_t size : {std::size_t{4} << 10, std::size_t{64} << 10, std::size_t{1} << 20}) {
+        std::string bytes = make_table(size);
+        for (bool durable : {false, true}) {
+            std::vector<double> us;
+            us.reserve(static_cast<std::size_t>(iters));
+            for (int i = 0; i < iters; ++i) {
+                auto t0 = Clock::now();
+                if (!replace_file(target, bytes, durable)) return 1;
+                us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+            }
+            std::sort(us.begin(), us.end());
+            double mean = 0;
+            for (double u : us) mean += u;
+            mean /= static_cast<double>(us.size());
+            double p99 = us[std::min(us.size() - 1, us.size() * 99 / 100)];
+            std::printf("%-8s %-8s %12.1f %12.1f %12.1f %10.1f\n",
+                        (std::to_string(bytes.size() >> 10) + "K").c_str(), durable ? "fsync" : "nosync",
+                        us[us.size() / 2], p99, mean, static_cast<double>(bytes.size()) / mean);
+        }
+    }
+    fs::remove(target, ec);
+    fs::remove(dir, ec); // only if empty
+    return 0;
+}
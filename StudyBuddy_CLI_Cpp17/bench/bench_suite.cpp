@@ -0,0 +1,160 @@
+// End-to-end benchmark at several data sizes. For each scale a seeded dataset is
+// generated (tools/datagen.h), then timed:
+//   load_all          Storage construction: CSV parse, merge and index build
+//   suggest_matches   classmates with overlapping hours in one of the student's courses
+//   top_matches       the same, ranked, k=10
+//   schedule_session  propose a session to a classmate at a shared free hour (journal
+//                     append included)
+//   parse_command     look up and parse the same proposals as CLI command lines, the
+//                     per-command overhead of batch and daemon mode
+//   save_*            rewrite one table, waiting for the background write to finish
+//
+//   make bench                                     # 10k and 100k students
+//   make bench BENCH_SCALES="10000 100000 1000000" # 1M is opt-in (several GB of RAM)
+//   ./bench/bench_suite [--seed S] <students>...
+//
+// Prints latency percentiles (microseconds) and throughput per operation.
+#include "command_table.h"
+#include "datagen.h"
+#include "services_course.h"
+#include "services_availability.h"
+#include "services_match.h"
+#include "services_session.h"
+#include "storage.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static constexpr int kSamples = 300; // per query/mutation operation
+static constexpr int kRepeats = 3;   // per load/save operation
+
+static void report(const char* op, std::vector<double> us) {
+    if (us.empty()) return;
+    std::sort(us.begin(), us.end());
+    double total = 0;
+    for (double u : us) total += u;
+    auto pct = [&](std::size_t p){ return us[std::min(us.size() - 1, us.size() * p / 100)]; };
+    std::printf("  %-18s %6zu %12.1f %12.1f %12.1f %12.1f %12.0f\n", op, us.size(), pct(50), pct(90), pct(99),
+                us.back(), static_cast<double>(us.size()) / (total / 1e6));
+}
+
+// Time `fn` `n` times, in microseconds.
+static std::vector<double> sample(int n, const std::function<void(int)>& fn) {
+    std::vector<double> us;
+    us.reserve(static_cast<std::size_t>(n));
+    for (int i = 0; i < n; ++i) {
+        auto t0 = Clock::now();
+        fn(i);
+        us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+    }
+    return us;
+}
+
+static void run_scale(std::size_t students, std::uint64_t seed) {
+    fs::path dir = fs::path("bench_data") / std::to_string(students);
+    DatasetSpec spec;
+    spec.students = students;
+    spec.seed = seed;
+    DatasetStats stats;
+    auto t0 = Clock::now();
+    if (!generate_dataset(dir, spec, stats)) return;
+    double genMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    std::printf("== %zu students (seed %llu): %zu courses, %zu enrollments, %zu slots, %zu sessions; generated in %.0f ms\n",
+                students, static_cast<unsigned long long>(seed), stats.courses, stats.enrollments, stats.availability,
+                stats.sessions, genMs);
+    std::printf("  %-18s %6s %12s %12s %12s %12s %12s\n", "op", "n", "p50_us", "p90_us", "p99_us", "max_us", "ops/s");
+
+    report("load_all", sample(kRepeats, [&](int){ Storage s(dir.string(), Durability::None); }));
+
+    Storage store(dir.string(), Durability::None);
+    CourseService courseSvc(store);
+    AvailabilityService availSvc(store);
+    MatchService matchSvc(store, courseSvc);
+    SessionService sessionSvc(store, courseSvc, availSvc);
+
+    // Query subjects: students with at least one course, picked by a fixed stride.
+    std::vector<std::pair<int, std::string>> subjects;
+    for (std::size_t i = 0; subjects.size() < static_cast<std::size_t>(kSamples) && i < students * 4; ++i) {
+        int id = static_cast<int>((i * 7919) % students) + 1;
+        const auto& enr = store.enrollments_of(id);
+        if (!enr.empty()) subjects.push_back({id, store.courses.code(enr[i % enr.size()].course_id)});
+    }
+    auto subject = [&](int i) -> const std::pair<int, std::string>& { return subjects[static_cast<std::size_t>(i) % subjects.size()]; };
+
+    std::size_t found = 0;
+    report("suggest_matches", sample(kSamples, [&](int i){
+        std::string err;
+        found += matchSvc.suggest_matches(subject(i).first, subject(i).second, err).size();
+    }));
+    report("top_matches", sample(kSamples, [&](int i){
+        std::string err;
+        found += matchSvc.top_matches(subject(i).first, subject(i).second, 10, {}, MatchService::kDefaultPreferredWeight, err).size();
+    }));
+
+    // Each proposal goes to a classmate at their first shared free hour, so most succeed.
+    struct Proposal { int organizer, invitee, day, start; std::string code; };
+    std::vector<Proposal> proposals;
+    for (int i = 0; proposals.size() < static_cast<std::size_t>(kSamples) && i < kSamples * 20; ++i) {
+        const auto& [id, code] = subject(i);
+        const auto& roster = store.students_in(*store.courses.find(code));
+        int other = roster[static_cast<std::size_t>(i) % roster.size()];
+        if (other == id) continue;
+        WeekMask free = store.availability_mask(id) & store.availability_mask(other)
+                      & ~store.busy_mask(id) & ~store.busy_mask(other);
+        for (std::size_t b = 0; b < free.size(); ++b) {
+            if (free.test(b)) { proposals.push_back({id, other, static_cast<int>(b / kHoursPerDay), static_cast<int>(b % kHoursPerDay), code}); break; }
+        }
+    }
+    int scheduled = 0;
+    report("schedule_session", sample(static_cast<int>(proposals.size()), [&](int i){
+        const auto& p = proposals[static_cast<std::size_t>(i)];
+        std::string err;
+        if (sessionSvc.schedule_session(p.organizer, p.code, p.day, p.start, std::vector<int>{p.invitee}, err)) ++scheduled;
+    }));
+
+    std::vector<std::string> lines;
+    for (const auto& p : proposals) {
+        lines.push_back("schedule_session --course \"" + p.code + "\" --day " + std::to_string(p.day) + " --start "
+                        + std::to_string(p.start) + " --invite " + std::to_string(p.invitee));
+    }
+    int parsed = 0;
+    report("parse_command", sample(static_cast<int>(lines.size()), [&](int i){
+        std::string_view rest;
+        const CommandSpec* spec = find_command(command_name(lines[static_cast<std::size_t>(i)], &rest));
+        CommandArgs args;
+        if (spec && parse_command_args(*spec, rest, args)) ++parsed;
+    }));
+
+    report("save_students", sample(kRepeats, [&](int){ store.save_students(); store.flush(); }));
+    report("save_enrollments", sample(kRepeats, [&](int){ store.save_enrollments(); store.flush(); }));
+    report("save_availability", sample(kRepeats, [&](int){ store.save_availability(); store.flush(); }));
+    report("save_sessions", sample(kRepeats, [&](int){ store.save_sessions(); store.flush(); }));
+    report("save_participants", sample(kRepeats, [&](int){ store.save_participants(); store.flush(); }));
+    std::printf("  (%zu matches returned, %d sessions scheduled, %d command lines parsed)\n\n", found, scheduled, parsed);
+}
+
+int main(int argc, char** argv) {
+    std::uint64_t seed = 42;
+    std::vector<std::size_t> scales;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) seed = std::stoull(argv[++i]);
+        else scales.push_back(std::stoul(arg));
+    }
+    if (scales.empty()) scales = {10000, 100000};
+    for (std::size_t n : scales) {
+        run_scale(n, seed);
+        std::error_code ec;
+        fs::remove_all(fs::path("bench_data") / std::to_string(n), ec);
+    }
+    std::error_code ec;
+    fs::remove(fs::path("bench_data"), ec); // only if empty
+    return 0;
+}
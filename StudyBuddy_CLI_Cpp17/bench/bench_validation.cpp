@@ -0,0 +1,50 @@
+// Cost of the input validators against the std::regex versions they replaced, on a mix
+// of valid and invalid emails and course codes like those seen by add_course,
+// schedule_session, search_matches and profile edits.
+//
+//   make bench                          # part of the bench target
+//   ./bench/bench_validation [iters]    # default 200000 calls per case
+//
+// Prints nanoseconds per call and the speedup for each case.
+#include "validation.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <regex>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+template <typename F>
+static double ns_per_call(const std::vector<std::string>& inputs, int iters, F&& fn) {
+    int accepted = 0;
+    auto t0 = Clock::now();
+    for (int i = 0; i < iters; ++i) accepted += fn(inputs[static_cast<std::size_t>(i) % inputs.size()]);
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    if (accepted < 0) std::printf("unreachable\n"); // keeps the loop from being optimized out
+    return ns / iters;
+}
+
+int main(int argc, char** argv) {
+    int iters = argc >= 2 ? std::max(1, std::atoi(argv[1])) : 200000;
+    const std::vector<std::string> emails = {
+        "jlee3@clemson.edu", "avery.tiger@g.clemson.edu", "s104233@clemson.edu", "not-an-email",
+        "two@@clemson.edu", "spaces in@clemson.edu", "x@y", "firstname.lastname.long@department.university.edu",
+    };
+    const std::vector<std::string> courses = {
+        "CPSC 2120", "MATH 1060", "ENGL 103", "PHYS 1220", "cpsc 2120", "CPSC2120", "ABCDEF 1234", "BIO 12345",
+    };
+    const std::regex emailRe(R"(^[^@\s]+@[^@\s]+\.[^@\s]+$)");
+    const std::regex courseRe(R"(^[A-Z]{2,5} [0-9]{3,4}$)");
+
+    std::printf("%-8s %14s %14s %10s\n", "case", "regex_ns", "scan_ns", "speedup");
+    double re = ns_per_call(emails, iters, [&](const std::string& s){ return std::regex_match(s, emailRe); });
+    double scan = ns_per_call(emails, iters, [](const std::string& s){ return is_valid_email(s); });
+    std::printf("%-8s %14.1f %14.1f %9.0fx\n", "email", re, scan, re / scan);
+    re = ns_per_call(courses, iters, [&](const std::string& s){ return std::regex_match(s, courseRe); });
+    scan = ns_per_call(courses, iters, [](const std::string& s){ return is_valid_course(s); });
+    std::printf("%-8s %14.1f %14.1f %9.0fx\n", "course", re, scan, re / scan);
+    return 0;
+}
@@ -8,11 +8,36 @@
 #include "services_availability.h"
 #include "services_match.h"
 #include "services_session.h"
+#include "metrics.h"
+#include "command_table.h"
+#include <array>
+#include <iostream>
 
 class CLI {
 public:
-    CLI();
+    // Per-session state. The interactive loop and batch mode each use one; the daemon
+    // (server.h) keeps one per connection, so every client has its own login.
+    struct Client {
+        int current_user{-1};
+        bool running{true};              // cleared by 'exit'
+        std::ostream* out{&std::cout};   // command output
+        std::ostream* errs{&std::cerr};  // errors and usage messages
+    };
+
+    explicit CLI(const std::string& data_dir = "data", Durability mode = Durability::Periodic);
     int run();
+    // Non-interactive: run every line of `in` (blank and '#' lines skipped), keep going
+    // after failures, then print a per-command summary. Returns 1 if any command failed.
+    int run_batch(std::istream& in);
+    // One command line for `client`: looked up in kCommandTable (command_table.h), then
+    // handle_command under the storage lock (shared for read commands, exclusive
+    // otherwise), with exceptions reported as failures. Safe to call from several
+    // threads. Returns false if the command failed.
+    bool run_command(Client& client, std::string_view line);
+    // True for commands that never modify Storage (lists, searches, login, help).
+    static bool is_read_command(std::string_view name);
+
+    Storage& storage() { return store; }
 
 private:
     Storage store;
@@ -22,30 +47,38 @@ private:
     MatchService matchSvc;
     SessionService sessionSvc;
 
-    int current_user{-1};
-
-    void print_help() const;
-    void print_welcome() const;
-
-    void handle_command(const std::string& line);
-    void cmd_create_profile(const std::unordered_map<std::string,std::string>& args);
-    void cmd_login(const std::unordered_map<std::string,std::string>& args);
-    void cmd_whoami() const;
-    void cmd_edit_profile(const std::unordered_map<std::string,std::string>& args);
-    void cmd_add_course(const std::unordered_map<std::string,std::string>& args);
-    void cmd_remove_course(const std::unordered_map<std::string,std::string>& args);
-    void cmd_list_courses();
-    void cmd_add_availability(const std::unordered_map<std::string,std::string>& args);
-    void cmd_remove_availability(const std::unordered_map<std::string,std::string>& args);
-    void cmd_list_availability();
-    void cmd_search_matches(const std::unordered_map<std::string,std::string>& args);
-    void cmd_schedule_session(const std::unordered_map<std::string,std::string>& args);
-    void cmd_confirm_session(const std::unordered_map<std::string,std::string>& args);
-    void cmd_cancel_session(const std::unordered_map<std::string,std::string>& args);
-    void cmd_list_sessions();
-    void cmd_list_invitations();
-
-    bool require_logged_in() const;
+    // cmd.<name> latency per command, indexed by CommandId. Filled in by the constructor
+    // and read-only afterwards, so concurrent commands use them without locking.
+    std::array<LatencyHistogram*, kCommandCount> commandHists{};
+    LatencyHistogram* unknownCommandHist{nullptr};
+
+    void print_help(const Client& client) const;
+    void print_welcome(const Client& client) const;
+
+    bool handle_command(Client& client, const CommandSpec& spec, std::string_view args); // false if the command failed
+    bool cmd_create_profile(Client& client, const CommandArgs& args);
+    bool cmd_login(Client& client, const CommandArgs& args);
+    bool cmd_whoami(const Client& client) const;
+    bool cmd_edit_profile(Client& client, const CommandArgs& args);
+    bool cmd_add_course(Client& client, const CommandArgs& args);
+    bool cmd_remove_course(Client& client, const CommandArgs& args);
+    bool cmd_list_courses(const Client& client);
+    bool cmd_add_availability(Client& client, const CommandArgs& args);
+    bool cmd_remove_availability(Client& client, const CommandArgs& args);
+    bool cmd_list_availability(const Client& client);
+    bool cmd_search_matches(Client& client, const CommandArgs& args);
+    bool cmd_match_matrix(Client& client, const CommandArgs& args);
+    bool cmd_find_common_slots(Client& client, const CommandArgs& args);
+    bool cmd_auto_schedule(Client& client, const CommandArgs& args);
+    bool cmd_schedule_session(Client& client, const CommandArgs& args);
+    bool cmd_confirm_session(Client& client, const CommandArgs& args);
+    bool cmd_cancel_session(Client& client, const CommandArgs& args);
+    bool cmd_list_sessions(const Client& client);
+    bool cmd_list_invitations(const Client& client);
+    bool cmd_stats(const Client& client) const;
+
+    bool require_logged_in(const Client& client) const;
+    void print_usage(const Client& client, const CommandSpec& spec) const;
 };
 
 #endif // STUDY_BUDDY_CLI_H
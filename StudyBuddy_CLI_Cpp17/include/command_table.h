@@ -0,0 +1,232 @@
+#ifndef STUDY_BUDDY_COMMAND_TABLE_H
+#define STUDY_BUDDY_COMMAND_TABLE_H
+
+#include "id_span.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Declarative table of CLI commands. Each entry names the command, whether it can run
+// under the shared storage lock, whether it needs a login, and its typed flags. The
+// CLI dispatches on it, parse_command_args() checks arguments against it, and the help
+// and usage text are generated from it, so a new command is one entry here plus one
+// handler. Names are found through a perfect hash computed at compile time.
+
+enum class ArgType : std::uint8_t {
+    Text,    // any string
+    Int,     // base-10 integer
+    Course,  // course code ("CPSC 2120"); anything else is BAD_COURSE
+    IdList,  // comma-separated integers ("3,7, 9"); empty entries are skipped
+    Choice,  // one of the '|'-separated words of the placeholder
+};
+
+struct FlagSpec {
+    std::string_view name;          // "--course"; an empty name ends the list
+    ArgType type{ArgType::Text};
+    bool required{false};
+    std::string_view placeholder;   // value as shown in usage text
+    const char* badValue{nullptr};  // error code for a value that does not parse (BAD_ARGUMENT if null)
+};
+
+constexpr std::size_t kMaxFlags = 5;
+
+enum class CommandId : std::uint8_t {
+    CreateProfile, Login, Whoami, EditProfile, AddCourse, RemoveCourse, ListCourses,
+    AddAvailability, RemoveAvailability, ListAvailability, SearchMatches, MatchMatrix,
+    FindCommonSlots, AutoSchedule, ScheduleSession, ConfirmSession, CancelSession,
+    ListSessions, ListInvitations, Stats, Help, Exit,
+};
+
+struct CommandSpec {
+    CommandId id;
+    std::string_view name;
+    bool readOnly;    // never modifies Storage or writes files, so it runs under the shared lock
+    bool needsLogin;
+    std::array<FlagSpec, kMaxFlags> flags;
+
+    constexpr std::size_t flag_count() const {
+        std::size_t n = 0;
+        while (n < kMaxFlags && !flags[n].name.empty()) ++n;
+        return n;
+    }
+};
+
+// In CommandId order, which is also the order of the help text.
+inline constexpr CommandSpec kCommandTable[] = {
+    {CommandId::CreateProfile, "create_profile", false, false,
+        {{{"--name", ArgType::Text, true, "<str>"}, {"--email", ArgType::Text, true, "<str>"},
+          {"--passcode", ArgType::Text, false, "<str>"}}}},
+    {CommandId::Login, "login", true, false,
+        {{{"--email", ArgType::Text, true, "<str>"}, {"--passcode", ArgType::Text, false, "<str>"}}}},
+    {CommandId::Whoami, "whoami", true, true, {}},
+    {CommandId::EditProfile, "edit_profile", false, true,
+        {{{"--name", ArgType::Text, false, "<str>"}, {"--email", ArgType::Text, false, "<str>"}}}},
+    {CommandId::AddCourse, "add_course", false, true, {{{"--code", ArgType::Course, true, "<DEPT NUM>"}}}},
+    {CommandId::RemoveCourse, "remove_course", false, true, {{{"--code", ArgType::Course, true, "<DEPT NUM>"}}}},
+    {CommandId::ListCourses, "list_courses", true, true, {}},
+    {CommandId::AddAvailability, "add_availability", false, true,
+        {{{"--day", ArgType::Int, true, "<0..6>", "BAD_RANGE"}, {"--start", ArgType::Int, true, "<0..23>", "BAD_RANGE"},
+          {"--end", ArgType::Int, true, "<1..24>", "BAD_RANGE"}}}},
+    {CommandId::RemoveAvailability, "remove_availability", false, true,
+        {{{"--day", ArgType::Int, true, "<0..6>", "BAD_RANGE"}, {"--start", ArgType::Int, true, "<0..23>", "BAD_RANGE"},
+          {"--end", ArgType::Int, true, "<1..24>", "BAD_RANGE"}}}},
+    {CommandId::ListAvailability, "list_availability", true, true, {}},
+    {CommandId::SearchMatches, "search_matches", true, true,
+        {{{"--course", ArgType::Course, true, "<DEPT NUM>"}, {"--top", ArgType::Int, false, "<N>", "BAD_TOP"},
+          {"--sort", ArgType::Choice, false, "earliest|overlap"}, {"--prefer", ArgType::IdList, false, "<day,day,..>", "BAD_DAY"},
+          {"--weight", ArgType::Int, false, "<N>", "BAD_WEIGHT"}}}},
+    // Writes an export file, so it takes the exclusive lock and never overlaps compaction.
+    {CommandId::MatchMatrix, "match_matrix", false, true,
+        {{{"--course", ArgType::Course, true, "<DEPT NUM>"}, {"--out", ArgType::Text, true, "<file>"},
+          {"--format", ArgType::Choice, false, "csv|bin"}}}},
+    {CommandId::FindCommonSlots, "find_common_slots", true, true,
+        {{{"--course", ArgType::Course, true, "<DEPT NUM>"}, {"--with", ArgType::IdList, true, "<id,id,..>", "INV_ID"}}}},
+    {CommandId::AutoSchedule, "auto_schedule", false, true,
+        {{{"--course", ArgType::Course, true, "<DEPT NUM>"}, {"--size", ArgType::Int, true, "<N>", "BAD_SIZE"}}}},
+    {CommandId::ScheduleSession, "schedule_session", false, true,
+        {{{"--course", ArgType::Course, true, "<DEPT NUM>"}, {"--day", ArgType::Int, true, "<0..6>", "BAD_TIME"},
+          {"--start", ArgType::Int, true, "<0..23>", "BAD_TIME"}, {"--invite", ArgType::IdList, true, "<id,id,..>", "INV_ID"}}}},
+    {CommandId::ConfirmSession, "confirm_session", false, true, {{{"--id", ArgType::Int, true, "<session_id>", "NO_SESSION"}}}},
+    {CommandId::CancelSession, "cancel_session", false, true,
+        {{{"--id", ArgType::Int, true, "<session_id>", "NO_SESSION"}, {"--reason", ArgType::Text, false, "<text>"}}}},
+    {CommandId::ListSessions, "list_sessions", true, true, {}},
+    {CommandId::ListInvitations, "list_invitations", true, true, {}},
+    {CommandId::Stats, "stats", true, false, {}},
+    {CommandId::Help, "help", true, false, {}},
+    {CommandId::Exit, "exit", true, false, {}},
+};
+
+constexpr std::size_t kCommandCount = sizeof(kCommandTable) / sizeof(kCommandTable[0]);
+
+namespace command_table_detail {
+
+constexpr std::uint32_t fnv1a(std::string_view s) {
+    std::uint32_t h = 2166136261u;
+    for (char c : s) { h ^= static_cast<unsigned char>(c); h *= 16777619u; }
+    return h;
+}
+
+// Multiplicative hashing of the FNV-1a value into 64 slots; the multiplier is the
+// first odd number that gives every command its own slot.
+constexpr unsigned kSlotBits = 6;
+constexpr std::size_t kSlots = std::size_t{1} << kSlotBits;
+
+constexpr std::size_t slot_of(std::uint32_t h, std::uint32_t mult) {
+    return static_cast<std::uint32_t>(h * mult) >> (32 - kSlotBits);
+}
+
+constexpr std::uint32_t find_multiplier() {
+    for (std::uint32_t mult = 1; mult < 1000000; mult += 2) {
+        bool used[kSlots] = {};
+        bool clash = false;
+        for (std::size_t i = 0; i < kCommandCount && !clash; ++i) {
+            std::size_t s = slot_of(fnv1a(kCommandTable[i].name), mult);
+            clash = used[s];
+            used[s] = true;
+        }
+        if (!clash) return mult;
+    }
+    return 0;
+}
+
+constexpr std::uint32_t kMultiplier = find_multiplier();
+static_assert(kMultiplier != 0, "no perfect hash for the command names");
+
+constexpr std::array<std::uint8_t, kSlots> build_slots() {
+    std::array<std::uint8_t, kSlots> slots{};
+    for (auto& s : slots) s = 0xFF;
+    for (std::size_t i = 0; i < kCommandCount; ++i) {
+        slots[slot_of(fnv1a(kCommandTable[i].name), kMultiplier)] = static_cast<std::uint8_t>(i);
+    }
+    return slots;
+}
+
+constexpr std::array<std::uint8_t, kSlots> kSlotTable = build_slots();
+
+constexpr bool ids_match_positions() {
+    for (std::size_t i = 0; i < kCommandCount; ++i) {
+        if (static_cast<std::size_t>(kCommandTable[i].id) != i) return false;
+    }
+    return true;
+}
+static_assert(ids_match_positions(), "kCommandTable must be in CommandId order");
+
+} // namespace command_table_detail
+
+// One hash and one string compare; nullptr for an unknown name.
+constexpr const CommandSpec* find_command(std::string_view name) {
+    using namespace command_table_detail;
+    std::uint8_t i = kSlotTable[slot_of(fnv1a(name), kMultiplier)];
+    return i != 0xFF && kCommandTable[i].name == name ? &kCommandTable[i] : nullptr;
+}
+
+// Arguments of one command line, checked against its schema. Values are views into the
+// command line, or into `scratch` when a quoted value had to be unescaped, and id lists
+// are parsed into `idStore`. Lines too big for those fixed buffers spill the rest into
+// `textSpill`/`idSpill` on the heap instead of failing. It must not outlive the line it
+// was parsed from.
+class CommandArgs {
+public:
+    enum class Status : std::uint8_t {
+        Ok,
+        Usage,        // missing required flag, missing value, stray word, or bad choice
+        UnknownFlag,  // `flag` is not in the schema
+        BadValue,     // `flag` has a value of the wrong type; see error_code()
+    };
+
+    CommandArgs() = default;
+    CommandArgs(const CommandArgs&) = delete;
+    CommandArgs& operator=(const CommandArgs&) = delete;
+
+    Status status() const { return result; }
+    std::string_view failed_flag() const { return flag; }
+    // Error code for BadValue: the flag's badValue, BAD_COURSE, or BAD_ARGUMENT.
+    const char* error_code() const;
+
+    bool has(std::string_view name) const;
+    std::string_view text(std::string_view name) const;  // empty if absent
+    int integer(std::string_view name, int fallback = 0) const;
+    IdSpan ids(std::string_view name) const;             // empty if absent; views into this object
+
+    // Ids and unescaped bytes held inline; anything beyond goes to the heap.
+    static constexpr std::size_t kInlineIds = 64;
+    static constexpr std::size_t kScratchBytes = 512;
+
+private:
+    friend bool parse_command_args(const CommandSpec& spec, std::string_view args, CommandArgs& out);
+
+    int slot(std::string_view name) const;
+
+    const CommandSpec* spec{nullptr};
+    Status result{Status::Ok};
+    std::string_view flag;
+    std::array<bool, kMaxFlags> present{};
+    std::array<std::string_view, kMaxFlags> values{};
+    std::array<int, kMaxFlags> ints{};
+    std::array<IdSpan, kMaxFlags> idLists{};
+    std::size_t idsUsed{0};
+    int idStore[kInlineIds];
+    std::size_t scratchUsed{0};
+    char scratch[kScratchBytes];
+    std::deque<std::vector<int>> idSpill;   // id lists that did not fit in idStore
+    std::deque<std::string> textSpill;      // unescaped values that did not fit in scratch
+};
+
+// Fill `out` from the text after the command name. Flags may come in any order and the
+// last repeat wins; values may be quoted ("CPSC 2120", with "" for a literal quote).
+// Returns false with out.status() saying why. Allocates only for lines that overflow
+// CommandArgs' inline buffers.
+bool parse_command_args(const CommandSpec& spec, std::string_view args, CommandArgs& out);
+
+// First word of a command line and the text after it (leading blanks skipped).
+std::string_view command_name(std::string_view line, std::string_view* rest = nullptr);
+
+// "search_matches --course <DEPT NUM> [--top <N>] ..."
+void write_usage(std::ostream& os, const CommandSpec& spec);
+
+#endif // STUDY_BUDDY_COMMAND_TABLE_H
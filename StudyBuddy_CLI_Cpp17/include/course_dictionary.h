@@ -0,0 +1,29 @@
+#ifndef STUDY_BUDDY_COURSE_DICTIONARY_H
+#define STUDY_BUDDY_COURSE_DICTIONARY_H
+
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Interns course codes ("CPSC 2120") to dense integer ids 0..size()-1, so rows and
+// indexes carry an int and comparisons are integer compares. Codes are only
+// spelled out at the CSV/journal/CLI boundary. An id never changes while rows refer to it.
+class CourseDictionary {
+public:
+    int intern(std::string_view code);                   // existing id, or a new one
+    std::optional<int> find(std::string_view code) const; // nullopt if never seen
+    const std::string& code(int id) const;
+    std::size_t size() const { return codes.size(); }
+    void clear();
+    // Forget the codes interned after the first `count` (Transaction rollback); no row
+    // may still refer to them.
+    void truncate(std::size_t count);
+
+private:
+    std::deque<std::string> codes;                  // a deque, so the keys below stay valid
+    std::unordered_map<std::string_view, int> ids;  // views of `codes`
+};
+
+#endif // STUDY_BUDDY_COURSE_DICTIONARY_H
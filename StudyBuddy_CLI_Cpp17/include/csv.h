@@ -1,8 +1,9 @@
-
 #ifndef STUDY_BUDDY_CSV_H
 #define STUDY_BUDDY_CSV_H
 
+#include <cstddef>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace csv {
@@ -11,6 +12,16 @@ namespace csv {
 // Returns empty vector if parsing fails (e.g., unmatched quote).
 std::vector<std::string> parse_line(const std::string& line);
 
+// Allocation-free variant for bulk loading. Fills `fields` with views into `line`;
+// only a field that needs unescaping ("" or quotes mid-field) is copied, into
+// `scratch`. Views stay valid until the next call that reuses the same buffers.
+// Returns false on an unmatched quote.
+bool parse_line(std::string_view line, std::vector<std::string_view>& fields, std::string& scratch);
+
+// Parse a whole field as a base-10 integer (surrounding blanks allowed).
+bool parse_int(std::string_view field, int& out);
+bool parse_size(std::string_view field, std::size_t& out);
+
 // Escape a single CSV field per RFC4180-ish rules.
 std::string escape_field(const std::string& field);
 
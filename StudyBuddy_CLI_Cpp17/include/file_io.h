@@ -0,0 +1,66 @@
+#ifndef STUDY_BUDDY_FILE_IO_H
+#define STUDY_BUDDY_FILE_IO_H
+
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// Read-only view of a whole file. Uses mmap where available so loaders can scan
+// the page cache directly; elsewhere the file is read into an owned buffer.
+// A missing or empty file yields an empty view.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool ok() const { return opened; }
+    std::string_view view() const { return std::string_view(data, size); }
+
+private:
+    const char* data{nullptr};
+    std::size_t size{0};
+    bool mapped{false};
+    bool opened{false};
+    std::string fallback;
+
+    void release();
+};
+
+// Append-only file on a POSIX descriptor (stdio elsewhere, where sync() is only a
+// flush). Used for the journal, where each group commit is one write().
+class AppendFile {
+public:
+    AppendFile() = default;
+    ~AppendFile();
+
+    AppendFile(const AppendFile&) = delete;
+    AppendFile& operator=(const AppendFile&) = delete;
+
+    bool open(const std::filesystem::path& path); // creates the file if missing
+    bool is_open() const { return fd >= 0 || file != nullptr; }
+    bool write(std::string_view bytes);           // all of it, retrying short writes
+    bool sync();                                  // fsync
+    bool truncate();                              // drop the contents; later writes start at 0
+    void close();
+
+private:
+    int fd{-1};
+    std::FILE* file{nullptr};
+    std::filesystem::path where;
+};
+
+// Replace `path` with `bytes`: write a sibling ".tmp" file in one write(), then rename
+// it over `path`, so a reader or a crash sees either the old contents or the new ones.
+// When `durable`, the temp file is fsynced before the rename and the directory after it,
+// so the new contents survive a power loss once this returns true.
+bool replace_file(const std::filesystem::path& path, std::string_view bytes, bool durable = true);
+
+#endif // STUDY_BUDDY_FILE_IO_H
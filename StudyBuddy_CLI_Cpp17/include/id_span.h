@@ -0,0 +1,34 @@
+#ifndef STUDY_BUDDY_ID_SPAN_H
+#define STUDY_BUDDY_ID_SPAN_H
+
+#include <cstddef>
+#include <vector>
+
+// Read-only view of a run of ints (student ids, days), like C++20's std::span<const int>.
+// Services take id lists as IdSpan so the CLI can pass ids parsed into CommandArgs
+// without building a vector; other callers pass a vector. The viewed ints must
+// outlive the call.
+class IdSpan {
+public:
+    constexpr IdSpan() = default;
+    constexpr IdSpan(const int* data, std::size_t size): first(data), count(size) {}
+    IdSpan(const std::vector<int>& ids): first(ids.data()), count(ids.size()) {}
+
+    constexpr const int* begin() const { return first; }
+    constexpr const int* end() const { return first + count; }
+    constexpr std::size_t size() const { return count; }
+    constexpr bool empty() const { return count == 0; }
+    constexpr int operator[](std::size_t i) const { return first[i]; }
+
+    friend bool operator==(IdSpan a, IdSpan b) {
+        if (a.count != b.count) return false;
+        for (std::size_t i = 0; i < a.count; ++i) if (a.first[i] != b.first[i]) return false;
+        return true;
+    }
+
+private:
+    const int* first{nullptr};
+    std::size_t count{0};
+};
+
+#endif // STUDY_BUDDY_ID_SPAN_H
@@ -0,0 +1,83 @@
+#ifndef STUDY_BUDDY_METRICS_H
+#define STUDY_BUDDY_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Latency histogram with power-of-two buckets: bucket i counts samples of
+// [2^i, 2^(i+1)) nanoseconds. record() is a handful of relaxed atomic adds, so it
+// is safe and cheap from any thread; percentiles are accurate to within 2x.
+class LatencyHistogram {
+public:
+    static constexpr std::size_t kBuckets = 64;
+
+    struct Snapshot {
+        std::uint64_t count{0};
+        std::uint64_t sum_ns{0};
+        std::uint64_t max_ns{0};
+        std::array<std::uint64_t, kBuckets> buckets{};
+
+        double mean_ns() const { return count ? static_cast<double>(sum_ns) / static_cast<double>(count) : 0.0; }
+        // Upper bound of the bucket holding the p-th percentile (0 < p <= 100), capped at max_ns.
+        std::uint64_t percentile_ns(double p) const;
+    };
+
+    void record(std::uint64_t ns) noexcept;
+    Snapshot snapshot() const;
+
+private:
+    std::array<std::atomic<std::uint64_t>, kBuckets> buckets{}; // their total is the count
+    std::atomic<std::uint64_t> sum{0};
+    std::atomic<std::uint64_t> max{0};
+};
+
+// Named histograms for the whole process. Look a histogram up once (registration takes
+// a lock) and keep the reference: references stay valid for the life of the program.
+//   cmd.<name>        one CLI command, including waiting for the storage lock
+//   storage.parse     reading the CSV tables or snapshot.bin into memory
+//   storage.index     rebuilding the secondary indices and masks
+//   storage.save      serializing one table for a rewrite
+//   storage.fsync     one fsync of a table file, its directory or the journal
+//   journal.append    one group-commit write to the journal
+class Metrics {
+public:
+    static Metrics& global();
+
+    LatencyHistogram& histogram(const std::string& name);
+    std::vector<std::pair<std::string, LatencyHistogram::Snapshot>> snapshot() const; // sorted by name
+
+    // Table of every histogram with samples: count, mean, p50/p90/p99 and max in microseconds.
+    void print(std::ostream& os) const;
+    // The same data plus raw buckets as JSON, for tooling.
+    bool write_json(const std::filesystem::path& path) const;
+
+private:
+    mutable std::mutex mtx;
+    std::vector<std::pair<std::string, std::unique_ptr<LatencyHistogram>>> entries;
+};
+
+// Records the lifetime of the enclosing scope into a histogram.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyHistogram& h): hist(h), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        hist.record(static_cast<std::uint64_t>(ns));
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    LatencyHistogram& hist;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // STUDY_BUDDY_METRICS_H
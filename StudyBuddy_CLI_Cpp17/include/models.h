@@ -20,7 +20,7 @@ struct Student {
 
 struct Enrollment {
     int student_id{};
-    std::string course_code;
+    int course_id{}; // Storage::courses id of the course code
 };
 
 struct Availability {
@@ -32,7 +32,7 @@ struct Availability {
 
 struct Session {
     int id{};
-    std::string course_code;
+    int course_id{}; // Storage::courses id of the course code
     int day{};
     int start{};
     int duration{1};
@@ -0,0 +1,93 @@
+#ifndef STUDY_BUDDY_PERSISTENCE_H
+#define STUDY_BUDDY_PERSISTENCE_H
+
+#include "file_io.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// When journal appends reach stable storage:
+//   Fsync    - append() returns after the record is written and fsynced
+//   Periodic - append() returns once queued; the journal is fsynced about once a second
+//   None     - append() returns once queued; syncing is left to the OS (file
+//              replacements are not fsynced either)
+enum class Durability { Fsync, Periodic, None };
+
+// Writes the journal and table files on a background thread so commands never wait
+// on the disk (except in Fsync mode). Jobs run in submission order. Journal appends
+// queued together become one write() and at most one fsync (group commit).
+class PersistenceWorker {
+public:
+    PersistenceWorker(std::filesystem::path journal_path, Durability mode);
+    ~PersistenceWorker(); // finishes every queued job and syncs the journal
+
+    PersistenceWorker(const PersistenceWorker&) = delete;
+    PersistenceWorker& operator=(const PersistenceWorker&) = delete;
+
+    // Journal lines. In Fsync mode, waits for them and returns whether they were written.
+    // The other modes do the same while the journal is failing (the last journal write
+    // failed), so after one failure callers see the next ones; a successful write ends it.
+    bool append(std::string lines);
+    // Replace a whole file (see replace_file; fsynced unless the mode is None), after
+    // everything queued before it.
+    void replace(std::filesystem::path path, std::string bytes);
+    // Empty the journal, after everything queued before it. Skipped (the journal is
+    // kept for replay) while any file's last replace() failed, or while appends_lost()
+    // unless `rewroteAll` says every table was just replaced from memory.
+    void truncate_journal(bool rewroteAll = false);
+    // Files whose last replace() failed, as of the jobs finished so far. A later
+    // successful replace() of the same path takes it off the list.
+    std::vector<std::filesystem::path> failed_replaces();
+    // Whether a journal write failed since the last truncate_journal(true), so some
+    // records exist only in memory until every table is rewritten.
+    bool appends_lost();
+    // Wait until everything queued so far is written; false if any job failed since
+    // the previous drain().
+    bool drain();
+
+    Durability mode() const { return durability; }
+
+private:
+    enum class JobKind { Append, Replace, Truncate };
+    struct Job {
+        JobKind kind;
+        std::filesystem::path path;
+        std::string bytes;
+        bool rewroteAll{false}; // Truncate: see truncate_journal()
+    };
+
+    std::filesystem::path journalPath;
+    Durability durability;
+    AppendFile journal;
+
+    std::mutex mtx;
+    std::condition_variable wake;     // worker: new jobs or stopping
+    std::condition_variable finished; // callers: completed advanced
+    std::deque<Job> jobs;
+    std::uint64_t queued{0};    // tickets handed out
+    std::uint64_t completed{0}; // tickets finished
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> failedRanges; // [first, last] tickets, until drain()
+    bool stopping{false};
+    bool unsynced{false};      // journal written since the last fsync (worker thread only)
+    std::vector<std::filesystem::path> failedReplaces; // see failed_replaces()
+    bool appendsLost{false};                           // see appends_lost()
+    std::atomic<bool> journalFailing{false}; // the last journal write failed
+    std::chrono::steady_clock::time_point lastSync;
+    std::thread thread;
+
+    std::uint64_t enqueue(Job job);
+    bool wait_for(std::uint64_t ticket);
+    void run();
+    bool write_journal(const std::string& bytes);
+    bool sync_journal();
+};
+
+#endif // STUDY_BUDDY_PERSISTENCE_H
@@ -0,0 +1,71 @@
+#ifndef STUDY_BUDDY_SERVER_H
+#define STUDY_BUDDY_SERVER_H
+
+#include "cli.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Daemon mode: one process owns the Storage and serves CLI commands to many clients
+// over a Unix domain socket, so concurrent users share one copy of the data instead
+// of overwriting each other's CSVs.
+//
+// Wire format, per request: the client sends one command line ending in '\n'. The
+// server answers "<ok> <out_bytes> <err_bytes>\n" followed by the command's output
+// and error text. After 'exit' the server closes the connection. A line longer than
+// 16 KiB gets a LINE_TOO_LONG error reply and the connection is closed.
+class Server {
+public:
+    Server(CLI& cli, std::string socket_path);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    // Accept and serve clients until stop(). In the `foreground` daemon, SIGINT/SIGTERM
+    // also stop it and the listening socket is announced on stdout. Pending changes are
+    // compacted and flushed before returning. Non-zero if the socket could not be set up
+    // or that final save failed.
+    int run(bool foreground = false);
+    void stop() { stopping = true; }
+
+private:
+    CLI& cli;
+    std::string socketPath;
+    std::atomic<bool> stopping{false};
+
+    std::mutex connMtx;
+    std::vector<std::thread> workers;
+    std::vector<int> connFds;                     // open client sockets
+    std::vector<std::thread::id> finishedWorkers; // joined by the accept loop
+
+    void serve(int fd);
+};
+
+// Client side of the daemon protocol.
+class ServerConnection {
+public:
+    ServerConnection() = default;
+    ~ServerConnection();
+
+    ServerConnection(const ServerConnection&) = delete;
+    ServerConnection& operator=(const ServerConnection&) = delete;
+
+    bool open(const std::string& socket_path);
+    bool is_open() const { return fd >= 0; }
+    // Send one command; fills the command's output and error text. Returns false if the
+    // connection failed. `ok` is whether the command itself succeeded.
+    bool request(const std::string& line, std::string& out, std::string& err, bool& ok);
+    void close();
+
+private:
+    int fd{-1};
+    std::string pending; // bytes read past the previous reply
+};
+
+// study_buddy --connect: forward stdin lines to the daemon, print its replies.
+int run_client(const std::string& socket_path);
+
+#endif // STUDY_BUDDY_SERVER_H
@@ -3,15 +3,17 @@
 #define STUDY_BUDDY_COURSE_SERVICE_H
 
 #include "storage.h"
+#include <string_view>
 
 class CourseService {
 public:
     explicit CourseService(Storage& s): store(s) {}
 
-    bool add_course(int student_id, const std::string& course_code, std::string& err);
-    bool remove_course(int student_id, const std::string& course_code, std::string& err);
+    bool add_course(int student_id, std::string_view course_code, std::string& err);
+    bool remove_course(int student_id, std::string_view course_code, std::string& err);
     std::vector<std::string> list_courses(int student_id) const;
-    bool enrolled(int student_id, const std::string& course_code) const;
+    bool enrolled(int student_id, std::string_view course_code) const;
+    bool enrolled(int student_id, int course_id) const;
 
 private:
     Storage& store;
@@ -2,20 +2,58 @@
 #ifndef STUDY_BUDDY_MATCH_SERVICE_H
 #define STUDY_BUDDY_MATCH_SERVICE_H
 
+#include "id_span.h"
 #include "storage.h"
 #include "services_course.h"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
 
 struct MatchCandidate {
     int classmate_id;
     std::string classmate_name;
     // list of (day, hours)
     std::vector<std::pair<int, std::vector<int>>> overlaps;
+    int score{0}; // overlapping hours, preferred days counted twice (top_matches only)
+};
+
+// Weekly overlap hours between every pair of students in a course. Row/column i is
+// student_ids[i] (ascending); hours[i * n + j] is shared hours, the diagonal a
+// student's own weekly hours.
+struct MatchMatrix {
+    std::vector<int> student_ids;
+    std::vector<std::uint16_t> hours;
+
+    std::size_t size() const { return student_ids.size(); }
+    std::uint16_t at(std::size_t i, std::size_t j) const { return hours[i * student_ids.size() + j]; }
 };
 
 class MatchService {
 public:
     MatchService(Storage& s, const CourseService& cs): store(s), courseSvc(cs) {}
-    std::vector<MatchCandidate> suggest_matches(int student_id, const std::string& course_code, std::string& err) const;
+
+    // Classmate count at which suggest_matches spreads its scan over the shared pool.
+    std::size_t parallelThreshold{512};
+
+    std::vector<MatchCandidate> suggest_matches(int student_id, std::string_view course_code, std::string& err) const;
+    // Weight of a shared hour on a preferred day when the caller does not choose one.
+    static constexpr int kDefaultPreferredWeight = 2;
+
+    // The k best classmates by score, best first; ties go to the earliest shared hour,
+    // then name. The score counts each shared hour once, or `preferred_weight` times
+    // (at least 1, else BAD_WEIGHT) on `preferred_days`. Keeps a k-sized heap, and only
+    // the winners get their overlap runs built.
+    std::vector<MatchCandidate> top_matches(int student_id, std::string_view course_code, std::size_t k,
+                                            IdSpan preferred_days, int preferred_weight, std::string& err) const;
+    // All-pairs overlap for a course in one pass over packed masks, row blocks on the shared pool.
+    MatchMatrix overlap_matrix(std::string_view course_code, std::string& err) const;
+    // Where match_matrix may write `name`: <data dir>/exports/<name>, with the directory
+    // created on demand. Absolute names, ".." components, names that resolve outside the
+    // export directory and names that resolve to a Storage file are BAD_PATH.
+    std::optional<std::filesystem::path> export_path(std::string_view name, std::string& err) const;
+    // CSV (header row of ids, then one row per student) or the binary layout in services_match.cpp.
+    static bool write_matrix(const MatchMatrix& m, const std::filesystem::path& path, bool binary);
 private:
     Storage& store;
     const CourseService& courseSvc;
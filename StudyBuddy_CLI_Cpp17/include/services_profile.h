@@ -4,14 +4,21 @@
 
 #include "storage.h"
 #include <optional>
+#include <string_view>
 
 class ProfileService {
 public:
     explicit ProfileService(Storage& s): store(s) {}
 
-    std::optional<int> create_profile(const std::string& name, const std::string& email, const std::optional<std::string>& passcode);
-    bool edit_profile_name(int student_id, const std::string& new_name);
-    bool edit_profile_email(int student_id, const std::string& new_email);
+    std::optional<int> create_profile(std::string_view name, std::string_view email, std::optional<std::string_view> passcode);
+    bool edit_profile_name(int student_id, std::string_view new_name);
+    bool edit_profile_email(int student_id, std::string_view new_email);
+
+    // Same operations, reporting the error code in `err` instead of printing anything.
+    std::optional<int> create_profile(std::string_view name, std::string_view email,
+                                      std::optional<std::string_view> passcode, std::string& err);
+    bool edit_profile_name(int student_id, std::string_view new_name, std::string& err);
+    bool edit_profile_email(int student_id, std::string_view new_email, std::string& err);
 private:
     Storage& store;
 };
@@ -2,20 +2,30 @@
 #ifndef STUDY_BUDDY_SESSION_SERVICE_H
 #define STUDY_BUDDY_SESSION_SERVICE_H
 
+#include "id_span.h"
 #include "storage.h"
 #include "services_course.h"
 #include "services_availability.h"
 
+// One hour [start, start+1) on `day` when a whole group is free, inside the
+// maximal free window [window_start, window_end) on that day.
+struct CommonSlot {
+    int day;
+    int start;
+    int window_start;
+    int window_end;
+};
+
 class SessionService {
 public:
     SessionService(Storage& s, const CourseService& cs, const AvailabilityService& as)
         : store(s), courseSvc(cs), availSvc(as) {}
 
-    bool schedule_session(int organizer_id, const std::string& course_code, int day, int start,
-                          const std::vector<int>& invitees, std::string& err);
+    bool schedule_session(int organizer_id, std::string_view course_code, int day, int start,
+                          IdSpan invitees, std::string& err);
 
     bool confirm_session(int actor_id, int session_id, std::string& err);
-    bool cancel_session(int actor_id, int session_id, const std::string& reason, std::string& err);
+    bool cancel_session(int actor_id, int session_id, std::string_view reason, std::string& err);
 
     std::vector<Session> list_sessions_for(int student_id) const;
     std::vector<Session> list_sessions_by_status_for(int student_id, SessionStatus status) const;
@@ -23,7 +33,19 @@ public:
 
     bool has_conflict(int student_id, int day, int start) const;
 
+    // Hours where the requester and every id in `with` are available and not booked in
+    // a confirmed session; longest windows first, then in week order.
+    std::vector<CommonSlot> find_common_slots(int requester_id, std::string_view course_code,
+                                              IdSpan with, std::string& err) const;
+
+    // Split the course's students into groups of at most group_size and propose one
+    // session per group at the hour the most still-ungrouped students are free.
+    // The lowest id in a group organizes it; students never free alongside anyone stay out.
+    std::vector<Session> auto_schedule(int requester_id, std::string_view course_code, int group_size, std::string& err);
+
 private:
+    Session propose(int course_id, int day, int start, int organizer_id, IdSpan invitees);
+
     Storage& store;
     const CourseService& courseSvc;
     const AvailabilityService& availSvc;
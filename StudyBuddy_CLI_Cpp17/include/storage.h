@@ -1,27 +1,43 @@
-
 #ifndef STUDY_BUDDY_STORAGE_H
 #define STUDY_BUDDY_STORAGE_H
 
 #include "models.h"
+#include "course_dictionary.h"
+#include "week_mask.h"
+#include "persistence.h"
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
+class LatencyHistogram;
 
 class Storage {
 public:
     // In-memory state
     std::unordered_map<int, Student> students;
-    std::unordered_map<std::string, int> studentsByEmail; // email->id
+    std::unordered_map<std::string, int> studentsByEmail; // email->id; look up with student_by_email
+
+    CourseDictionary courses; // course code<->course_id used by enrollments and sessions
 
-    std::vector<Enrollment> enrollments;
-    std::unordered_multimap<std::string, int> enrollmentsByCourse; // course->student_id
+    // Row tables are grouped by their owning key so per-user reads and writes
+    // touch only that user's rows.
+    std::unordered_map<int, std::vector<Enrollment>> enrollmentsByStudent; // student_id->enrollments
+    std::unordered_map<int, std::vector<int>> enrollmentsByCourse; // course_id->student ids
+
+    std::unordered_map<int, std::vector<Availability>> availabilityByStudent; // student_id->slots
+    std::unordered_map<int, WeekMask> availabilityMasks; // student_id->hours covered by their slots
 
-    std::vector<Availability> availability;
-    
     std::unordered_map<int, Session> sessions;
-    std::vector<SessionParticipant> participants;
+    std::unordered_map<int, std::vector<SessionParticipant>> participantsBySession; // session_id->participants
+    std::unordered_map<int, std::vector<int>> sessionsByStudent; // student_id->sessions they organize or joined
+    std::unordered_map<int, WeekMask> busyMasks; // student_id->hours booked in CONFIRMED sessions
 
     int nextStudentId{1};
     int nextSessionId{1};
@@ -33,15 +49,121 @@ public:
     std::filesystem::path availabilityFile;
     std::filesystem::path sessionsFile;
     std::filesystem::path participantsFile;
+    std::filesystem::path journalFile;
+    std::filesystem::path snapshotFile;
+
+    // Journal records since the last compaction.
+    std::size_t journalRecords{0};
+    std::size_t compactThreshold{4096};
+
+    // Journal appends and table rewrites run on a background PersistenceWorker; `mode`
+    // sets when an append is durable (see Durability).
+    Storage(const std::string& data_dir = "data", Durability mode = Durability::Periodic);
 
-    Storage(const std::string& data_dir = "data");
+    // Wait for every queued journal append and file write; false if any failed.
+    bool flush();
+
+    // True if `path` resolves, through any symlinks, to a file this Storage reads or
+    // writes: a table, the journal, the snapshot, or one of their ".tmp" siblings.
+    bool owns_file(const std::filesystem::path& path) const;
+
+    // Reader-writer lock over all tables for multi-threaded callers (the daemon). Reads
+    // hold read_lock() and run concurrently; any mutation, compact() and load_all() need
+    // write_lock(). Single-threaded callers (console, batch mode) may skip it.
+    std::shared_lock<std::shared_mutex> read_lock() const { return std::shared_lock<std::shared_mutex>(tableMtx); }
+    std::unique_lock<std::shared_mutex> write_lock() { return std::unique_lock<std::shared_mutex>(tableMtx); }
 
     void load_all();
-    void save_students();
-    void save_enrollments();
-    void save_availability();
-    void save_sessions();
-    void save_participants();
+    // Rewrite one table file; false if the write failed (known only in Fsync mode,
+    // otherwise the persistence worker reports it on the next flush()).
+    bool save_students();
+    bool save_enrollments();
+    bool save_availability();
+    bool save_sessions();
+    bool save_participants();
+
+    // Append-only mutation journal. Services record each change here instead of
+    // rewriting whole tables; load_all replays it on top of the CSV snapshots. Inside a
+    // Transaction the record is buffered and commit() reports the write. Outside one,
+    // they return false if the append failed (as PersistenceWorker::append reports it),
+    // and the table is only marked for compaction once the record was written.
+    bool journal_student(const Student& s);
+    bool journal_enrollment(const Enrollment& e, bool added);
+    bool journal_availability(const Availability& a, bool added);
+    bool journal_session(const Session& s);
+    bool journal_participant(const SessionParticipant& p);
+
+    // Compact binary copy of every table and the next ids (layout in snapshot.cpp).
+    // load_all reads snapshotFile instead of the CSVs when it is at least as new as
+    // all of them, and compact() keeps an existing snapshotFile up to date.
+    bool write_snapshot(const std::filesystem::path& path);
+    bool import_snapshot(const std::filesystem::path& path); // replaces all in-memory tables
+
+    // Fold the journal into the CSV snapshots and truncate it. Only tables with journal
+    // records since the last compaction are rewritten. maybe_compact() does so only past
+    // compactThreshold; call it between commands, never mid-mutation. If a table cannot
+    // be written the journal is kept (and the table stays dirty); returns false.
+    bool compact();
+    void maybe_compact();
+
+    // Groups the journal records of several mutations into one append. While a
+    // Transaction is open, records are buffered in memory; commit() hands them to the
+    // persistence worker as one append. If that append fails, or the scope ends without
+    // commit(), the changes are undone in memory from the undo log (undo_* below), so a
+    // rollback costs only the rows the transaction touched. A failed append is reported
+    // to commit() in Fsync mode, and in the other modes once an earlier append has failed
+    // (see PersistenceWorker::append). Nested transactions join the outermost one, which
+    // alone commits or rolls back.
+    class Transaction {
+    public:
+        explicit Transaction(Storage& s);
+        ~Transaction();
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+        bool commit(); // false if the records could not be written (state is rolled back)
+
+    private:
+        Storage& store;
+        bool outermost;
+        bool done{false};
+        int nextStudentId; // id counters and dictionary size to restore on rollback
+        int nextSessionId;
+        std::size_t courseCount;
+
+        void rollback();
+    };
+
+    // Before-images for rollback. Inside a Transaction, call the matching undo_* before
+    // changing a student, a student's availability (slots and mask) or a session (row,
+    // participants and the indexes derived from them); outside one they do nothing.
+    // add_enrollment and remove_enrollment log their own inverse.
+    void undo_student(int student_id);
+    void undo_availability(int student_id);
+    void undo_session(int session_id);
+
+    // Index-maintaining mutators used by the services.
+    bool add_enrollment(const Enrollment& e);                                // false if already enrolled
+    bool remove_enrollment(int student_id, int course_id);                   // false if not enrolled
+    void upsert_participant(const SessionParticipant& p);
+    void link_session(int student_id, int session_id);
+    // Keep busyMasks current: mark_busy when a session becomes CONFIRMED, recompute_busy
+    // for each member when one is cancelled (another confirmed session may share the hour).
+    void mark_busy(const Session& s);
+    void recompute_busy(int student_id);
+
+    // Read-only lookups; missing keys yield an empty result.
+    std::optional<int> student_by_email(std::string_view email) const;
+    const std::vector<Enrollment>& enrollments_of(int student_id) const;
+    const std::vector<Availability>& availability_of(int student_id) const;
+    const std::vector<SessionParticipant>& participants_of(int session_id) const;
+    const std::vector<int>& sessions_of(int student_id) const;
+    const std::vector<int>& students_in(int course_id) const;
+
+    // Weekly availability bitmap for a student (all clear if they have no slots).
+    const WeekMask& availability_mask(int student_id) const;
+    // Hours the student is booked in a confirmed session, as organizer or confirmed participant.
+    const WeekMask& busy_mask(int student_id) const;
 
     // Helpers
     void recompute_indices();
@@ -49,7 +171,35 @@ public:
     void ensure_files();
 
 private:
-    void atomic_write(const std::filesystem::path& path, const std::vector<std::string>& lines);
+    // Bits for dirtyTables: which CSVs have journal records not yet folded in.
+    enum TableBit : unsigned {
+        kStudentsTable = 1u << 0,
+        kEnrollmentsTable = 1u << 1,
+        kAvailabilityTable = 1u << 2,
+        kSessionsTable = 1u << 3,
+        kParticipantsTable = 1u << 4,
+        kAllTables = (1u << 5) - 1,
+    };
+
+    std::unique_ptr<PersistenceWorker> persist;
+    mutable std::shared_mutex tableMtx;
+    unsigned dirtyTables{0};
+    std::size_t txnDepth{0};
+    std::string txnBuffer;      // journal lines of the open transaction
+    std::size_t txnRecords{0};
+    unsigned txnTables{0};      // dirtyTables bits of those lines, set on commit
+    std::vector<std::function<void()>> undoLog; // inverse of each change in the open transaction
+
+    static LatencyHistogram& save_histogram(); // storage.save (metrics.h)
+    bool atomic_write(const std::filesystem::path& path, const std::vector<std::string>& lines);
+    bool atomic_write(const std::filesystem::path& path, const std::string& bytes);
+    void load_csv_tables();
+    bool snapshot_is_fresh() const;
+    bool read_snapshot(const std::filesystem::path& path);
+    bool append_journal(const std::vector<std::string>& fields);
+    bool write_journal(const std::string& lines, std::size_t records, unsigned tables);
+    static unsigned table_of(std::string_view tag);
+    void replay_journal();
 };
 
 #endif // STUDY_BUDDY_STORAGE_H
@@ -0,0 +1,63 @@
+#ifndef STUDY_BUDDY_THREAD_POOL_H
+#define STUDY_BUDDY_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed-size work-stealing pool. Each worker owns a deque: tasks submitted from a
+// worker go to its own deque and are popped newest-first, tasks from other threads
+// are dealt round-robin, and an idle worker steals the oldest task of a busy one.
+// Tasks must not block waiting on other tasks of the same pool; callers submit a
+// batch and wait on the returned futures.
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t threads = 0); // 0 = one per hardware thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename F>
+    auto submit(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using R = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> fut = task->get_future();
+        enqueue([task]{ (*task)(); });
+        return fut;
+    }
+
+    std::size_t size() const { return workers.size(); }
+
+    // Process-wide pool shared by loaders and services.
+    static ThreadPool& shared();
+
+private:
+    struct WorkQueue {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mtx;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues; // one per worker
+    std::atomic<std::size_t> nextQueue{0};          // round-robin target for outside submits
+    std::atomic<std::size_t> pending{0};            // queued, not yet started
+
+    std::mutex sleepMtx;
+    std::condition_variable cv;
+    bool stopping{false};
+
+    void enqueue(std::function<void()> task);
+    bool try_pop(std::size_t self, std::function<void()>& task);
+    void worker_loop(std::size_t self);
+};
+
+#endif // STUDY_BUDDY_THREAD_POOL_H
@@ -0,0 +1,58 @@
+#ifndef STUDY_BUDDY_TRACE_H
+#define STUDY_BUDDY_TRACE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Opt-in span tracing in Chrome trace-event format (load the file in chrome://tracing
+// or https://ui.perfetto.dev). While tracing is off a span costs one atomic load.
+// While on, each thread appends finished spans to its own buffer; nothing is formatted
+// or written until write().
+//
+// Span names and categories must be string literals (or otherwise outlive the trace):
+// only the pointers are stored.
+//
+// At most span_limit() spans are kept per start(), across all threads, so a long
+// --serve run cannot grow the buffers without bound; later spans are counted in
+// dropped() and reported in the written file. Threads take their share of the limit
+// 256 spans at a time and count their own spans, so the cap adds no shared write per
+// span; a thread may hold up to 255 unused claims when the limit runs out.
+namespace trace {
+
+constexpr std::size_t kDefaultSpanLimit = std::size_t{1} << 20; // 32 MiB of events
+
+void start();
+void stop();
+bool enabled();
+void set_span_limit(std::size_t spans); // takes effect at the next start()
+std::size_t span_limit();
+std::size_t dropped(); // spans not kept since start() because the limit was reached
+// Write every span kept since start() as a JSON trace-event file, with the dropped
+// count under "otherData". Call it once the traced work is finished (it does not stop
+// threads that are still recording).
+bool write(const std::filesystem::path& path);
+
+class Span {
+public:
+    explicit Span(const char* name, const char* category = "app");
+    ~Span();
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    const char* name;
+    const char* category;
+    std::chrono::steady_clock::time_point begin;
+    bool active;
+};
+
+} // namespace trace
+
+#define STUDY_BUDDY_TRACE_CAT2(a, b) a##b
+#define STUDY_BUDDY_TRACE_CAT(a, b) STUDY_BUDDY_TRACE_CAT2(a, b)
+// Span covering the rest of the enclosing scope.
+#define TRACE_SCOPE(...) ::trace::Span STUDY_BUDDY_TRACE_CAT(traceSpan_, __LINE__)(__VA_ARGS__)
+
+#endif // STUDY_BUDDY_TRACE_H
@@ -2,10 +2,12 @@
 #ifndef STUDY_BUDDY_VALIDATION_H
 #define STUDY_BUDDY_VALIDATION_H
 
-#include <string>
+#include <string_view>
 
-bool is_valid_email(const std::string& email);
-bool is_valid_course(const std::string& code);
+// something@something.something, without whitespace or a second '@'.
+bool is_valid_email(std::string_view email);
+// "DEPT NUM": 2-5 capital letters, one space, 3-4 digits ("CPSC 2120").
+bool is_valid_course(std::string_view code);
 bool is_valid_day(int d);
 bool is_valid_hour(int h);
 bool is_valid_avail_range(int start, int end);
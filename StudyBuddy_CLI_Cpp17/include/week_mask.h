@@ -0,0 +1,55 @@
+#ifndef STUDY_BUDDY_WEEK_MASK_H
+#define STUDY_BUDDY_WEEK_MASK_H
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+// One bit per hour of the week (7 days x 24 hours = 168 bits, three 64-bit words).
+// Bit day*24 + hour is set when the hour [hour, hour+1) on that day is covered.
+constexpr int kHoursPerDay = 24;
+constexpr int kDaysPerWeek = 7;
+constexpr int kHoursPerWeek = kHoursPerDay * kDaysPerWeek;
+
+using WeekMask = std::bitset<kHoursPerWeek>;
+
+inline std::size_t week_bit(int day, int hour) {
+    return static_cast<std::size_t>(day * kHoursPerDay + hour);
+}
+
+// Set (or clear) hours [start, end) on `day`. Hours outside 0..23 and days outside
+// 0..6 are ignored.
+inline void set_hours(WeekMask& mask, int day, int start, int end, bool value = true) {
+    if (day < 0 || day >= kDaysPerWeek) return;
+    for (int h = std::max(start, 0); h < std::min(end, kHoursPerDay); ++h) mask.set(week_bit(day, h), value);
+}
+
+// False if any hour of [start, end) is unset or outside the week.
+inline bool covers_hours(const WeekMask& mask, int day, int start, int end) {
+    if (day < 0 || day >= kDaysPerWeek) return start >= end;
+    for (int h = start; h < end; ++h) {
+        if (h < 0 || h >= kHoursPerDay || !mask.test(week_bit(day, h))) return false;
+    }
+    return true;
+}
+
+// The same 168 bits as three plain words (bit b lives in word b/64), for tight loops
+// that AND and popcount many masks stored back to back.
+using PackedWeek = std::array<std::uint64_t, 3>;
+
+inline PackedWeek pack_week(const WeekMask& mask) {
+    PackedWeek words{};
+    for (std::size_t b = 0; b < mask.size(); ++b) {
+        if (mask.test(b)) words[b / 64] |= std::uint64_t{1} << (b % 64);
+    }
+    return words;
+}
+
+inline int shared_hours(const PackedWeek& a, const PackedWeek& b) {
+    return __builtin_popcountll(a[0] & b[0]) + __builtin_popcountll(a[1] & b[1])
+         + __builtin_popcountll(a[2] & b[2]);
+}
+
+#endif // STUDY_BUDDY_WEEK_MASK_H
@@ -1,315 +1,418 @@
-
 #include "cli.h"
+#include "metrics.h"
+#include "trace.h"
 #include "string_utils.h"
-#include "validation.h"
 #include <iostream>
 #include <sstream>
 
-CLI::CLI()
-: store("data"),
+CLI::CLI(const std::string& data_dir, Durability mode)
+: store(data_dir, mode),
   profileSvc(store),
   courseSvc(store),
   availSvc(store),
   matchSvc(store, courseSvc),
   sessionSvc(store, courseSvc, availSvc)
-{}
+{
+    for (const auto& spec : kCommandTable) {
+        commandHists[static_cast<std::size_t>(spec.id)] = &Metrics::global().histogram("cmd." + std::string(spec.name));
+    }
+    unknownCommandHist = &Metrics::global().histogram("cmd.unknown");
+}
 
-void CLI::print_welcome() const {
-    std::cout << "Study Buddy CLI — type 'help' for commands.\n";
+void CLI::print_welcome(const Client& client) const {
+    *client.out << "Study Buddy CLI — type 'help' for commands.\n";
+}
+
+void CLI::print_help(const Client& client) const {
+    *client.out << "Commands:\n";
+    for (const auto& spec : kCommandTable) {
+        *client.out << "  ";
+        write_usage(*client.out, spec);
+        *client.out << "\n";
+    }
 }
 
-void CLI::print_help() const {
-    std::cout << "Commands:\n"
-              << "  create_profile --name <str> --email <str> [--passcode <str>]\n"
-              << "  login --email <str> [--passcode <str>]\n"
-              << "  whoami\n"
-              << "  edit_profile [--name <str>] [--email <str>]\n"
-              << "  add_course --code <DEPT NUM>\n"
-              << "  remove_course --code <DEPT NUM>\n"
-              << "  list_courses\n"
-              << "  add_availability --day <0..6> --start <0..23> --end <1..24>\n"
-              << "  remove_availability --day <0..6> --start <..> --end <..>\n"
-              << "  list_availability\n"
-              << "  search_matches --course <DEPT NUM>\n"
-              << "  schedule_session --course <DEPT NUM> --day <0..6> --start <0..23> --invite <id,id,..>\n"
-              << "  confirm_session --id <session_id>\n"
-              << "  cancel_session --id <session_id> [--reason <text>]\n"
-              << "  list_sessions\n"
-              << "  list_invitations\n"
-              << "  help | exit\n";
+void CLI::print_usage(const Client& client, const CommandSpec& spec) const {
+    *client.errs << "Usage: ";
+    write_usage(*client.errs, spec);
+    *client.errs << "\n";
 }
 
-bool CLI::require_logged_in() const {
-    if (current_user < 0) {
-        std::cerr << "[ERROR] Not logged in. Use 'login --email <str>' or create_profile.\n";
+bool CLI::require_logged_in(const Client& client) const {
+    if (client.current_user < 0) {
+        *client.errs << "[ERROR] Not logged in. Use 'login --email <str>' or create_profile.\n";
         return false;
     }
     return true;
 }
 
-void CLI::cmd_create_profile(const std::unordered_map<std::string,std::string>& args) {
-    auto itN = args.find("--name");
-    auto itE = args.find("--email");
-    if (itN == args.end() || itE == args.end()) {
-        std::cerr << "Usage: create_profile --name <str> --email <str> [--passcode <str>]\n";
-        return;
-    }
-    std::optional<std::string> pw;
-    auto itP = args.find("--passcode");
-    if (itP != args.end()) pw = itP->second;
-    auto id = profileSvc.create_profile(itN->second, itE->second, pw);
-    if (id) current_user = *id;
+bool CLI::cmd_create_profile(Client& client, const CommandArgs& args) {
+    std::optional<std::string_view> pw;
+    if (args.has("--passcode")) pw = args.text("--passcode");
+    std::string_view email = args.text("--email");
+    std::string err;
+    auto id = profileSvc.create_profile(args.text("--name"), email, pw, err);
+    if (!id) { *client.errs << "[ERROR] " << err << ": " << email << "\n"; return false; }
+    *client.out << "Profile created: id=" << *id << "\n";
+    client.current_user = *id;
+    return true;
 }
 
-void CLI::cmd_login(const std::unordered_map<std::string,std::string>& args) {
-    auto itE = args.find("--email");
-    if (itE == args.end()) { std::cerr << "Usage: login --email <str> [--passcode <str>]\n"; return; }
-    auto it = store.studentsByEmail.find(itE->second);
-    if (it == store.studentsByEmail.end()) { std::cerr << "[ERROR] NO_SUCH_USER\n"; return; }
-    int id = it->second;
-    auto& stu = store.students[id];
-    auto itP = args.find("--passcode");
+bool CLI::cmd_login(Client& client, const CommandArgs& args) {
+    auto found = store.student_by_email(args.text("--email"));
+    if (!found) { *client.errs << "[ERROR] NO_SUCH_USER\n"; return false; }
+    int id = *found;
+    const auto& stu = store.students.at(id);
     if (stu.pass_hash) {
-        if (itP == args.end()) { std::cerr << "[ERROR] PASSCODE_REQUIRED\n"; return; }
-        std::hash<std::string> hasher;
-        if (*stu.pass_hash != hasher(itP->second)) { std::cerr << "[ERROR] BAD_PASSCODE\n"; return; }
+        if (!args.has("--passcode")) { *client.errs << "[ERROR] PASSCODE_REQUIRED\n"; return false; }
+        std::hash<std::string_view> hasher; // same value as std::hash<std::string> on the stored hash
+        if (*stu.pass_hash != hasher(args.text("--passcode"))) { *client.errs << "[ERROR] BAD_PASSCODE\n"; return false; }
     }
-    current_user = id;
-    std::cout << "Logged in as id=" << id << " (" << stu.name << ")\n";
+    client.current_user = id;
+    *client.out << "Logged in as id=" << id << " (" << stu.name << ")\n";
+    return true;
 }
 
-void CLI::cmd_whoami() const {
-    if (!require_logged_in()) return;
-    const auto& s = store.students.at(current_user);
-    std::cout << "Current user: id=" << s.id << " name=" << s.name << " email=" << s.email << "\n";
+bool CLI::cmd_whoami(const Client& client) const {
+    const auto& s = store.students.at(client.current_user);
+    *client.out << "Current user: id=" << s.id << " name=" << s.name << " email=" << s.email << "\n";
+    return true;
 }
 
-void CLI::cmd_edit_profile(const std::unordered_map<std::string,std::string>& args) {
-    if (!require_logged_in()) return;
+bool CLI::cmd_edit_profile(Client& client, const CommandArgs& args) {
     bool any = false;
-    auto itN = args.find("--name");
-    if (itN != args.end()) { any = profileSvc.edit_profile_name(current_user, itN->second) || any; }
-    auto itE = args.find("--email");
-    if (itE != args.end()) { any = profileSvc.edit_profile_email(current_user, itE->second) || any; }
-    if (!any) std::cout << "Nothing to update.\n";
+    std::string err;
+    if (args.has("--name")) {
+        if (profileSvc.edit_profile_name(client.current_user, args.text("--name"), err)) any = true;
+        else *client.errs << "[ERROR] " << err << "\n";
+    }
+    if (args.has("--email")) {
+        if (profileSvc.edit_profile_email(client.current_user, args.text("--email"), err)) any = true;
+        else *client.errs << "[ERROR] " << err << "\n";
+    }
+    if (!any) *client.out << "Nothing to update.\n";
+    return any;
 }
 
-void CLI::cmd_add_course(const std::unordered_map<std::string,std::string>& args) {
-    if (!require_logged_in()) return;
-    auto it = args.find("--code");
-    if (it == args.end()) { std::cerr << "Usage: add_course --code <DEPT NUM>\n"; return; }
+bool CLI::cmd_add_course(Client& client, const CommandArgs& args) {
     std::string err;
-    if (courseSvc.add_course(current_user, it->second, err)) {
-        std::cout << "Course added.\n";
-    } else {
-        std::cerr << "[ERROR] " << err << "\n";
-    }
+    if (!courseSvc.add_course(client.current_user, args.text("--code"), err)) { *client.errs << "[ERROR] " << err << "\n"; return false; }
+    *client.out << "Course added.\n";
+    return true;
 }
 
-void CLI::cmd_remove_course(const std::unordered_map<std::string,std::string>& args) {
-    if (!require_logged_in()) return;
-    auto it = args.find("--code");
-    if (it == args.end()) { std::cerr << "Usage: remove_course --code <DEPT NUM>\n"; return; }
+bool CLI::cmd_remove_course(Client& client, const CommandArgs& args) {
     std::string err;
-    if (courseSvc.remove_course(current_user, it->second, err)) {
-        std::cout << "Course removed.\n";
-    } else {
-        std::cerr << "[ERROR] " << err << "\n";
-    }
+    if (!courseSvc.remove_course(client.current_user, args.text("--code"), err)) { *client.errs << "[ERROR] " << err << "\n"; return false; }
+    *client.out << "Course removed.\n";
+    return true;
 }
 
-void CLI::cmd_list_courses() {
-    if (!require_logged_in()) return;
-    auto list = courseSvc.list_courses(current_user);
-    if (list.empty()) { std::cout << "(no courses)\n"; return; }
-    for (auto& c : list) std::cout << c << "\n";
+bool CLI::cmd_list_courses(const Client& client) {
+    auto list = courseSvc.list_courses(client.current_user);
+    if (list.empty()) { *client.out << "(no courses)\n"; return true; }
+    for (auto& c : list) *client.out << c << "\n";
+    return true;
 }
 
-void CLI::cmd_add_availability(const std::unordered_map<std::string,std::string>& args) {
-    if (!require_logged_in()) return;
-    auto d = args.find("--day"); auto s = args.find("--start"); auto e = args.find("--end");
-    if (d == args.end() || s == args.end() || e == args.end()) {
-        std::cerr << "Usage: add_availability --day <0..6> --start <0..23> --end <1..24>\n"; return;
-    }
+bool CLI::cmd_add_availability(Client& client, const CommandArgs& args) {
     std::string err;
-    if (availSvc.add_availability(current_user, std::stoi(d->second), std::stoi(s->second), std::stoi(e->second), err)) {
-        std::cout << "Availability added/merged.\n";
-    } else {
-        std::cerr << "[ERROR] " << err << "\n";
-    }
+    if (!availSvc.add_availability(client.current_user, args.integer("--day"), args.integer("--start"), args.integer("--end"), err)) { *client.errs << "[ERROR] " << err << "\n"; return false; }
+    *client.out << "Availability added/merged.\n";
+    return true;
 }
 
-void CLI::cmd_remove_availability(const std::unordered_map<std::string,std::string>& args) {
-    if (!require_logged_in()) return;
-    auto d = args.find("--day"); auto s = args.find("--start"); auto e = args.find("--end");
-    if (d == args.end() || s == args.end() || e == args.end()) {
-        std::cerr << "Usage: remove_availability --day <0..6> --start <..> --end <..>\n"; return;
-    }
+bool CLI::cmd_remove_availability(Client& client, const CommandArgs& args) {
     std::string msg;
-    if (availSvc.remove_availability_exact(current_user, std::stoi(d->second), std::stoi(s->second), std::stoi(e->second), msg)) {
-        std::cout << "Availability removed.\n";
-    } else {
-        std::cout << msg << "\n";
+    if (!availSvc.remove_availability_exact(client.current_user, args.integer("--day"), args.integer("--start"), args.integer("--end"), msg)) {
+        if (msg == "IO_WRITE") *client.errs << "[ERROR] " << msg << "\n";
+        else *client.out << msg << "\n";
+        return false;
     }
+    *client.out << "Availability removed.\n";
+    return true;
 }
 
-void CLI::cmd_list_availability() {
-    if (!require_logged_in()) return;
-    auto slots = availSvc.list_availability(current_user);
-    if (slots.empty()) { std::cout << "(no availability)\n"; return; }
+bool CLI::cmd_list_availability(const Client& client) {
+    auto slots = availSvc.list_availability(client.current_user);
+    if (slots.empty()) { *client.out << "(no availability)\n"; return true; }
     for (const auto& a : slots) {
-        std::cout << "Day " << a.day << ": " << a.start << "-" << a.end << "\n";
+        *client.out << "Day " << a.day << ": " << a.start << "-" << a.end << "\n";
     }
+    return true;
 }
 
-void CLI::cmd_search_matches(const std::unordered_map<std::string,std::string>& args) {
-    if (!require_logged_in()) return;
-    auto it = args.find("--course");
-    if (it == args.end()) { std::cerr << "Usage: search_matches --course <DEPT NUM>\n"; return; }
+bool CLI::cmd_search_matches(Client& client, const CommandArgs& args) {
+    std::string_view course = args.text("--course");
+    std::string_view sort = args.text("--sort");
+    // --top or --sort overlap selects the ranked, bounded search (10 results unless --top says otherwise).
+    // --prefer and --weight only shape that ranking, and --top cannot be combined with --sort earliest.
+    bool ranked = args.has("--top") || sort == "overlap";
+    if ((args.has("--top") && sort == "earliest") || (!ranked && args.has("--prefer"))
+        || (args.has("--weight") && !args.has("--prefer"))) {
+        *client.errs << "[ERROR] BAD_ARGS\n";
+        return false;
+    }
     std::string err;
-    auto matches = matchSvc.suggest_matches(current_user, it->second, err);
-    if (!err.empty()) { std::cerr << "[ERROR] " << err << "\n"; return; }
-    if (matches.empty()) { std::cout << "No matches found.\n"; return; }
+    std::vector<MatchCandidate> matches;
+    if (ranked) {
+        int k = args.integer("--top", 10);
+        if (k <= 0) { *client.errs << "[ERROR] BAD_TOP\n"; return false; }
+        matches = matchSvc.top_matches(client.current_user, course, static_cast<std::size_t>(k), args.ids("--prefer"),
+                                       args.integer("--weight", MatchService::kDefaultPreferredWeight), err);
+    } else {
+        matches = matchSvc.suggest_matches(client.current_user, course, err);
+    }
+    if (!err.empty()) { *client.errs << "[ERROR] " << err << "\n"; return false; }
+    if (matches.empty()) { *client.out << "No matches found.\n"; return true; }
     for (const auto& m : matches) {
-        std::cout << "#" << m.classmate_id << " " << m.classmate_name << ": ";
+        *client.out << "#" << m.classmate_id << " " << m.classmate_name;
+        if (ranked) *client.out << " (score " << m.score << ")";
+        *client.out << ": ";
         bool first = true;
         for (const auto& pr : m.overlaps) {
-            if (!first) std::cout << " | ";
+            if (!first) *client.out << " | ";
             first = false;
-            std::cout << "Day " << pr.first << " [";
+            *client.out << "Day " << pr.first << " [";
             for (size_t i = 0; i < pr.second.size(); ++i) {
-                if (i) std::cout << ",";
-                std::cout << pr.second[i];
+                if (i) *client.out << ",";
+                *client.out << pr.second[i];
             }
-            std::cout << "]";
+            *client.out << "]";
         }
-        std::cout << "\n";
+        *client.out << "\n";
     }
+    return true;
 }
 
-void CLI::cmd_schedule_session(const std::unordered_map<std::string,std::string>& args) {
-    if (!require_logged_in()) return;
-    auto c = args.find("--course"); auto d = args.find("--day"); auto s = args.find("--start"); auto inv = args.find("--invite");
-    if (c == args.end() || d == args.end() || s == args.end() || inv == args.end()) {
-        std::cerr << "Usage: schedule_session --course <DEPT NUM> --day <0..6> --start <0..23> --invite <id,id,..>\n"; return;
-    }
-    std::vector<int> ids;
-    std::stringstream ss(inv->second);
-    std::string tok;
-    while (std::getline(ss, tok, ',')) {
-        tok = trim(tok);
-        if (!tok.empty()) ids.push_back(std::stoi(tok));
-    }
+bool CLI::cmd_match_matrix(Client& client, const CommandArgs& args) {
     std::string err;
-    if (sessionSvc.schedule_session(current_user, c->second, std::stoi(d->second), std::stoi(s->second), ids, err)) {
-        std::cout << "Session PROPOSED. Awaiting confirmations.\n";
-    } else {
-        std::cerr << "[ERROR] " << err << "\n";
-    }
+    auto out = matchSvc.export_path(args.text("--out"), err);
+    if (!out) { *client.errs << "[ERROR] " << err << "\n"; return false; }
+    auto matrix = matchSvc.overlap_matrix(args.text("--course"), err);
+    if (!err.empty()) { *client.errs << "[ERROR] " << err << "\n"; return false; }
+    if (!MatchService::write_matrix(matrix, *out, args.text("--format") == "bin")) { *client.errs << "[ERROR] WRITE_FAILED\n"; return false; }
+    *client.out << "Wrote " << matrix.size() << "x" << matrix.size() << " overlap matrix to " << out->string() << "\n";
+    return true;
 }
 
-void CLI::cmd_confirm_session(const std::unordered_map<std::string,std::string>& args) {
-    if (!require_logged_in()) return;
-    auto it = args.find("--id");
-    if (it == args.end()) { std::cerr << "Usage: confirm_session --id <session_id>\n"; return; }
+bool CLI::cmd_find_common_slots(Client& client, const CommandArgs& args) {
     std::string err;
-    if (sessionSvc.confirm_session(current_user, std::stoi(it->second), err)) {
-        std::cout << "Confirmed.\n";
-    } else {
-        std::cerr << "[ERROR] " << err << "\n";
+    auto slots = sessionSvc.find_common_slots(client.current_user, args.text("--course"), args.ids("--with"), err);
+    if (!err.empty()) { *client.errs << "[ERROR] " << err << "\n"; return false; }
+    if (slots.empty()) { *client.out << "No common free hour.\n"; return true; }
+    for (const auto& s : slots) {
+        *client.out << "Day " << s.day << " " << s.start << ":00-" << (s.start+1) << ":00"
+             << " (free " << s.window_start << "-" << s.window_end << ")\n";
     }
+    return true;
 }
 
-void CLI::cmd_cancel_session(const std::unordered_map<std::string,std::string>& args) {
-    if (!require_logged_in()) return;
-    auto it = args.find("--id");
-    std::string reason;
-    auto r = args.find("--reason");
-    if (r != args.end()) reason = r->second; else reason = "No reason provided";
-    if (it == args.end()) { std::cerr << "Usage: cancel_session --id <session_id> [--reason <text>]\n"; return; }
+bool CLI::cmd_auto_schedule(Client& client, const CommandArgs& args) {
     std::string err;
-    if (sessionSvc.cancel_session(current_user, std::stoi(it->second), reason, err)) {
-        std::cout << "Cancelled.\n";
-    } else {
-        std::cerr << "[ERROR] " << err << "\n";
+    auto proposed = sessionSvc.auto_schedule(client.current_user, args.text("--course"), args.integer("--size"), err);
+    if (!err.empty()) { *client.errs << "[ERROR] " << err << "\n"; return false; }
+    if (proposed.empty()) { *client.out << "No group has a common free hour.\n"; return true; }
+    for (const auto& s : proposed) {
+        *client.out << "  [" << s.id << "] " << store.courses.code(s.course_id) << " Day " << s.day << " " << s.start << ":00-" << (s.start+1) << ":00"
+             << " organizer #" << s.organizer_id << ", " << store.participants_of(s.id).size() << " students\n";
     }
+    *client.out << proposed.size() << " session(s) PROPOSED. Awaiting confirmations.\n";
+    return true;
+}
+
+bool CLI::cmd_schedule_session(Client& client, const CommandArgs& args) {
+    std::string err;
+    if (!sessionSvc.schedule_session(client.current_user, args.text("--course"), args.integer("--day"), args.integer("--start"), args.ids("--invite"), err)) { *client.errs << "[ERROR] " << err << "\n"; return false; }
+    *client.out << "Session PROPOSED. Awaiting confirmations.\n";
+    return true;
+}
+
+bool CLI::cmd_confirm_session(Client& client, const CommandArgs& args) {
+    std::string err;
+    if (!sessionSvc.confirm_session(client.current_user, args.integer("--id"), err)) { *client.errs << "[ERROR] " << err << "\n"; return false; }
+    *client.out << "Confirmed.\n";
+    return true;
 }
 
-void CLI::cmd_list_sessions() {
-    if (!require_logged_in()) return;
-    auto list = sessionSvc.list_sessions_for(current_user);
-    if (list.empty()) { std::cout << "(no sessions)\n"; return; }
+bool CLI::cmd_cancel_session(Client& client, const CommandArgs& args) {
+    std::string_view reason = args.has("--reason") ? args.text("--reason") : "No reason provided";
+    std::string err;
+    if (!sessionSvc.cancel_session(client.current_user, args.integer("--id"), reason, err)) { *client.errs << "[ERROR] " << err << "\n"; return false; }
+    *client.out << "Cancelled.\n";
+    return true;
+}
+bool CLI::cmd_list_sessions(const Client& client) {
+    auto list = sessionSvc.list_sessions_for(client.current_user);
+    if (list.empty()) { *client.out << "(no sessions)\n"; return true; }
     // Print grouped by status
     auto print_group = [&](SessionStatus st, const char* title){
-        std::cout << title << ":\n";
+        *client.out << title << ":\n";
         for (const auto& s : list) {
             if (s.status != st) continue;
-            std::cout << "  [" << s.id << "] " << s.course_code << " Day " << s.day << " " << s.start << ":00-" << (s.start+1) << ":00"
-                      << " Organizer:" << s.organizer_id;
+            *client.out << "  [" << s.id << "] " << store.courses.code(s.course_id) << " Day " << s.day << " " << s.start << ":00-" << (s.start+1) << ":00"
+                 << " Organizer:" << s.organizer_id;
             // participants + confirmed flags
-            std::cout << " Participants:";
+            *client.out << " Participants:";
             bool first = true;
-            for (const auto& p : store.participants) {
-                if (p.session_id == s.id) {
-                    if (!first) std::cout << ",";
-                    first = false;
-                    std::cout << p.student_id << (p.confirmed ? "(Y)" : "(N)");
-                }
+            for (const auto& p : store.participants_of(s.id)) {
+                if (!first) *client.out << ",";
+                first = false;
+                *client.out << p.student_id << (p.confirmed ? "(Y)" : "(N)");
             }
-            if (s.status == SessionStatus::CANCELLED && s.cancel_reason) std::cout << " Reason:" << *s.cancel_reason;
-            std::cout << "\n";
+            if (s.status == SessionStatus::CANCELLED && s.cancel_reason) *client.out << " Reason:" << *s.cancel_reason;
+            *client.out << "\n";
         }
     };
     print_group(SessionStatus::PROPOSED, "PROPOSED");
     print_group(SessionStatus::CONFIRMED, "CONFIRMED");
     print_group(SessionStatus::CANCELLED, "CANCELLED");
+    return true;
 }
 
-void CLI::cmd_list_invitations() {
-    if (!require_logged_in()) return;
-    auto list = sessionSvc.list_pending_invitations_for(current_user);
-    if (list.empty()) { std::cout << "(no pending invitations)\n"; return; }
+bool CLI::cmd_list_invitations(const Client& client) {
+    auto list = sessionSvc.list_pending_invitations_for(client.current_user);
+    if (list.empty()) { *client.out << "(no pending invitations)\n"; return true; }
     for (const auto& s : list) {
-        std::cout << "  [" << s.id << "] " << s.course_code << " Day " << s.day << " " << s.start << ":00-" << (s.start+1) << ":00\n";
+        *client.out << "  [" << s.id << "] " << store.courses.code(s.course_id) << " Day " << s.day << " " << s.start << ":00-" << (s.start+1) << ":00\n";
+    }
+    return true;
+}
+
+bool CLI::cmd_stats(const Client& client) const {
+    Metrics::global().print(*client.out);
+    return true;
+}
+
+bool CLI::handle_command(Client& client, const CommandSpec& spec, std::string_view argText) {
+    if (spec.needsLogin && !require_logged_in(client)) return false;
+    CommandArgs args;
+    if (!parse_command_args(spec, argText, args)) {
+        switch (args.status()) {
+        case CommandArgs::Status::BadValue:
+            *client.errs << "[ERROR] " << args.error_code() << "\n";
+            return false;
+        case CommandArgs::Status::UnknownFlag:
+            *client.errs << "[ERROR] UNKNOWN_FLAG: " << args.failed_flag() << "\n";
+            break;
+        default:
+            break;
+        }
+        print_usage(client, spec);
+        return false;
+    }
+    switch (spec.id) {
+    case CommandId::CreateProfile: return cmd_create_profile(client, args);
+    case CommandId::Login: return cmd_login(client, args);
+    case CommandId::Whoami: return cmd_whoami(client);
+    case CommandId::EditProfile: return cmd_edit_profile(client, args);
+    case CommandId::AddCourse: return cmd_add_course(client, args);
+    case CommandId::RemoveCourse: return cmd_remove_course(client, args);
+    case CommandId::ListCourses: return cmd_list_courses(client);
+    case CommandId::AddAvailability: return cmd_add_availability(client, args);
+    case CommandId::RemoveAvailability: return cmd_remove_availability(client, args);
+    case CommandId::ListAvailability: return cmd_list_availability(client);
+    case CommandId::SearchMatches: return cmd_search_matches(client, args);
+    case CommandId::MatchMatrix: return cmd_match_matrix(client, args);
+    case CommandId::FindCommonSlots: return cmd_find_common_slots(client, args);
+    case CommandId::AutoSchedule: return cmd_auto_schedule(client, args);
+    case CommandId::ScheduleSession: return cmd_schedule_session(client, args);
+    case CommandId::ConfirmSession: return cmd_confirm_session(client, args);
+    case CommandId::CancelSession: return cmd_cancel_session(client, args);
+    case CommandId::ListSessions: return cmd_list_sessions(client);
+    case CommandId::ListInvitations: return cmd_list_invitations(client);
+    case CommandId::Stats: return cmd_stats(client);
+    case CommandId::Help: print_help(client); return true;
+    case CommandId::Exit: *client.out << "Goodbye\n"; client.running = false; return true;
     }
+    return false;
 }
 
-void CLI::handle_command(const std::string& line) {
-    auto tokens = split_tokens_quoted(line);
-    if (tokens.empty()) return;
-    std::string cmd = tokens[0];
-    auto args = parse_flags(tokens);
-    if (cmd == "help") { print_help(); return; }
-    if (cmd == "exit") { std::cout << "Goodbye\n"; std::exit(0); }
-    if (cmd == "create_profile") { cmd_create_profile(args); return; }
-    if (cmd == "login") { cmd_login(args); return; }
-    if (cmd == "whoami") { cmd_whoami(); return; }
-    if (cmd == "edit_profile") { cmd_edit_profile(args); return; }
-    if (cmd == "add_course") { cmd_add_course(args); return; }
-    if (cmd == "remove_course") { cmd_remove_course(args); return; }
-    if (cmd == "list_courses") { cmd_list_courses(); return; }
-    if (cmd == "add_availability") { cmd_add_availability(args); return; }
-    if (cmd == "remove_availability") { cmd_remove_availability(args); return; }
-    if (cmd == "list_availability") { cmd_list_availability(); return; }
-    if (cmd == "search_matches") { cmd_search_matches(args); return; }
-    if (cmd == "schedule_session") { cmd_schedule_session(args); return; }
-    if (cmd == "confirm_session") { cmd_confirm_session(args); return; }
-    if (cmd == "cancel_session") { cmd_cancel_session(args); return; }
-    if (cmd == "list_sessions") { cmd_list_sessions(); return; }
-    if (cmd == "list_invitations") { cmd_list_invitations(); return; }
-
-    std::cerr << "Unknown command. Type 'help'.\n";
+bool CLI::is_read_command(std::string_view name) {
+    const CommandSpec* spec = find_command(name);
+    return spec && spec->readOnly;
+}
+
+bool CLI::run_command(Client& client, std::string_view line) {
+    std::string_view argText;
+    std::string_view name = command_name(line, &argText);
+    if (name.empty()) return true;
+    const CommandSpec* spec = find_command(name);
+    if (!spec) {
+        ScopedTimer timer(*unknownCommandHist);
+        *client.errs << "Unknown command. Type 'help'.\n";
+        return false;
+    }
+    ScopedTimer timer(*commandHists[static_cast<std::size_t>(spec->id)]);
+    TRACE_SCOPE(spec->name.data(), "cmd"); // table names are string literals
+    std::shared_lock<std::shared_mutex> shared;
+    std::unique_lock<std::shared_mutex> exclusive;
+    if (spec->readOnly) shared = store.read_lock();
+    else exclusive = store.write_lock();
+    try {
+        return handle_command(client, *spec, argText);
+    } catch (const std::exception& e) { // a service throwing (out of memory, a broken invariant)
+        *client.errs << "[ERROR] " << e.what() << "\n";
+        return false;
+    }
 }
 
 int CLI::run() {
-    print_welcome();
+    Client client;
+    print_welcome(client);
     std::string line;
-    while (true) {
-        std::cout << "> ";
+    while (client.running) {
+        *client.out << "> ";
         if (!std::getline(std::cin, line)) break;
         line = trim(line);
         if (line.empty()) continue;
-        handle_command(line);
+        run_command(client, line);
+        store.maybe_compact();
     }
+    // Fold this run's journal into the CSV snapshots so the next start replays nothing.
+    if (store.journalRecords > 0) store.compact();
+    if (!store.flush()) { *client.errs << "[ERROR] IO_WRITE: some changes could not be written to disk\n"; return 1; }
     return 0;
 }
+
+// Output is flushed to stdout whenever this much has been buffered.
+static constexpr std::streamoff kBatchFlushBytes = 64 * 1024;
+
+int CLI::run_batch(std::istream& in) {
+    std::ostringstream buffered, diag;
+    Client client;
+    client.out = &buffered;
+    client.errs = &diag;
+    // One transaction for the whole batch: its journal records are written together.
+    Storage::Transaction txn(store);
+
+    std::vector<std::pair<std::size_t, std::string>> failures; // line number, command
+    std::size_t lineNo = 0, commands = 0;
+    std::string line;
+    while (client.running && std::getline(in, line)) {
+        ++lineNo;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') continue;
+        ++commands;
+        bool ok = run_command(client, line);
+        if (!ok) failures.push_back({lineNo, line.substr(0, line.find(' '))});
+        // Errors go straight to stderr, tagged with the script line they came from.
+        std::istringstream msgs(diag.str());
+        for (std::string msg; std::getline(msgs, msg); ) std::cerr << "line " << lineNo << ": " << msg << "\n";
+        diag.str("");
+        if (buffered.tellp() >= kBatchFlushBytes) { std::cout << buffered.str(); buffered.str(""); }
+    }
+    std::cout << buffered.str() << std::flush;
+    bool saved = txn.commit();
+    if (!saved) std::cerr << "[ERROR] IO_WRITE: batch changes could not be saved and were discarded\n";
+    if (store.journalRecords > 0) store.compact();
+    if (saved && !store.flush()) {
+        std::cerr << "[ERROR] IO_WRITE: batch changes could not be written to disk\n";
+        saved = false;
+    }
+
+    std::cerr << "Batch: " << commands << " command(s), " << (commands - failures.size()) << " ok, "
+              << failures.size() << " failed\n";
+    for (const auto& f : failures) std::cerr << "  line " << f.first << ": " << f.second << " FAILED\n";
+    return failures.empty() && saved ? 0 : 1;
+}
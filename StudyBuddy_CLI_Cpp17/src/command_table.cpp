@@ -0,0 +1,196 @@
+#include "command_table.h"
+#include "csv.h"
+#include "validation.h"
+#include <cctype>
+
+static bool is_blank(char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; }
+
+static std::string_view skip_blanks(std::string_view s) {
+    std::size_t i = 0;
+    while (i < s.size() && is_blank(s[i])) ++i;
+    return s.substr(i);
+}
+
+// Pass each of the comma-separated integers in `text` to add(), skipping blank
+// entries. False for an entry that is not an integer.
+template <typename AddFn>
+static bool parse_id_list(std::string_view text, AddFn add) {
+    while (true) {
+        std::size_t comma = text.find(',');
+        std::string_view entry = text.substr(0, comma);
+        if (!skip_blanks(entry).empty()) {
+            int v = 0;
+            if (!csv::parse_int(entry, v)) return false;
+            add(v);
+        }
+        if (comma == std::string_view::npos) return true;
+        text.remove_prefix(comma + 1);
+    }
+}
+
+static bool valid_choice(std::string_view placeholder, std::string_view value) {
+    while (true) {
+        std::size_t bar = placeholder.find('|');
+        if (placeholder.substr(0, bar) == value) return true;
+        if (bar == std::string_view::npos) return false;
+        placeholder.remove_prefix(bar + 1);
+    }
+}
+
+std::string_view command_name(std::string_view line, std::string_view* rest) {
+    line = skip_blanks(line);
+    std::size_t end = 0;
+    while (end < line.size() && !is_blank(line[end])) ++end;
+    if (rest) *rest = line.substr(end);
+    return line.substr(0, end);
+}
+
+int CommandArgs::slot(std::string_view name) const {
+    if (!spec) return -1;
+    for (std::size_t i = 0; i < spec->flag_count(); ++i) {
+        if (spec->flags[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+const char* CommandArgs::error_code() const {
+    int i = slot(flag);
+    if (i < 0) return "BAD_ARGUMENT";
+    const FlagSpec& f = spec->flags[static_cast<std::size_t>(i)];
+    if (f.badValue) return f.badValue;
+    return f.type == ArgType::Course ? "BAD_COURSE" : "BAD_ARGUMENT";
+}
+
+bool CommandArgs::has(std::string_view name) const {
+    int i = slot(name);
+    return i >= 0 && present[static_cast<std::size_t>(i)];
+}
+
+std::string_view CommandArgs::text(std::string_view name) const {
+    int i = slot(name);
+    return i >= 0 && present[static_cast<std::size_t>(i)] ? values[static_cast<std::size_t>(i)] : std::string_view{};
+}
+
+int CommandArgs::integer(std::string_view name, int fallback) const {
+    int i = slot(name);
+    return i >= 0 && present[static_cast<std::size_t>(i)] ? ints[static_cast<std::size_t>(i)] : fallback;
+}
+
+IdSpan CommandArgs::ids(std::string_view name) const {
+    int i = slot(name);
+    return i >= 0 && present[static_cast<std::size_t>(i)] ? idLists[static_cast<std::size_t>(i)] : IdSpan{};
+}
+
+// Next word of `rest`, with the quoting rules of the old split_tokens_quoted: quotes
+// may start anywhere in a word, "" inside quotes is a literal quote, and an unclosed
+// quote runs to the end of the line. A word without quotes, or wholly quoted without
+// "" inside, is returned as a view of the line; anything else is unescaped into
+// `scratch`, or into a new string in `spill` once scratch is full. Returns false at
+// the end of the line.
+static bool next_word(std::string_view& rest, std::string_view& word,
+                      char* scratch, std::size_t capacity, std::size_t& used, std::deque<std::string>& spill) {
+    rest = skip_blanks(rest);
+    if (rest.empty()) return false;
+    std::size_t end = 0;
+    bool inQuotes = false, quoted = false;
+    while (end < rest.size() && (inQuotes || !is_blank(rest[end]))) {
+        if (rest[end] == '"') {
+            quoted = true;
+            if (inQuotes && end + 1 < rest.size() && rest[end + 1] == '"') ++end;
+            else inQuotes = !inQuotes;
+        }
+        ++end;
+    }
+    std::string_view raw = rest.substr(0, end);
+    rest.remove_prefix(end);
+    if (!quoted) { word = raw; return true; }
+    if (raw.size() >= 2 && raw.front() == '"' && raw.back() == '"'
+        && raw.substr(1, raw.size() - 2).find('"') == std::string_view::npos) {
+        word = raw.substr(1, raw.size() - 2);
+        return true;
+    }
+    bool fits = capacity - used >= raw.size();
+    char* dst = fits ? scratch + used : spill.emplace_back(raw.size(), '\0').data();
+    std::size_t n = 0;
+    inQuotes = false;
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+        char c = raw[i];
+        if (c != '"') { dst[n++] = c; continue; }
+        if (inQuotes && i + 1 < raw.size() && raw[i + 1] == '"') { dst[n++] = '"'; ++i; }
+        else inQuotes = !inQuotes;
+    }
+    if (fits) used += n;
+    word = std::string_view(dst, n);
+    return true;
+}
+
+static bool is_flag(std::string_view word) { return word.size() >= 2 && word[0] == '-' && word[1] == '-'; }
+
+bool parse_command_args(const CommandSpec& spec, std::string_view args, CommandArgs& out) {
+    out.spec = &spec;
+    out.result = CommandArgs::Status::Ok;
+    out.flag = {};
+    out.present.fill(false);
+    out.idsUsed = 0;
+    out.scratchUsed = 0;
+    out.idSpill.clear();
+    out.textSpill.clear();
+    auto fail = [&](CommandArgs::Status s, std::string_view flag) { out.result = s; out.flag = flag; return false; };
+
+    std::string_view word;
+    bool haveWord = next_word(args, word, out.scratch, sizeof(out.scratch), out.scratchUsed, out.textSpill);
+    while (haveWord) {
+        if (!is_flag(word)) return fail(CommandArgs::Status::Usage, word);
+        int i = out.slot(word);
+        if (i < 0) return fail(CommandArgs::Status::UnknownFlag, word);
+        const FlagSpec& f = spec.flags[static_cast<std::size_t>(i)];
+        std::string_view value;
+        haveWord = next_word(args, value, out.scratch, sizeof(out.scratch), out.scratchUsed, out.textSpill);
+        if (!haveWord || is_flag(value)) return fail(CommandArgs::Status::Usage, f.name);
+        auto s = static_cast<std::size_t>(i);
+        switch (f.type) {
+        case ArgType::Text: break;
+        case ArgType::Int:
+            if (!csv::parse_int(value, out.ints[s])) return fail(CommandArgs::Status::BadValue, f.name);
+            break;
+        case ArgType::Course:
+            if (!is_valid_course(value)) return fail(CommandArgs::Status::BadValue, f.name);
+            break;
+        case ArgType::IdList: {
+            // The list goes after the earlier ones in idStore; if it outgrows idStore it
+            // moves to its own vector, so each list stays contiguous.
+            std::size_t first = out.idsUsed;
+            std::vector<int>* spilled = nullptr;
+            bool parsed = parse_id_list(value, [&](int v){
+                if (!spilled && out.idsUsed < CommandArgs::kInlineIds) { out.idStore[out.idsUsed++] = v; return; }
+                if (!spilled) {
+                    spilled = &out.idSpill.emplace_back(out.idStore + first, out.idStore + out.idsUsed);
+                    out.idsUsed = first;
+                }
+                spilled->push_back(v);
+            });
+            if (!parsed) return fail(CommandArgs::Status::BadValue, f.name);
+            out.idLists[s] = spilled ? IdSpan(*spilled) : IdSpan(out.idStore + first, out.idsUsed - first);
+            break;
+        }
+        case ArgType::Choice:
+            if (!valid_choice(f.placeholder, value)) return fail(CommandArgs::Status::Usage, f.name);
+            break;
+        }
+        out.present[s] = true;
+        out.values[s] = value;
+        haveWord = next_word(args, word, out.scratch, sizeof(out.scratch), out.scratchUsed, out.textSpill);
+    }
+    for (std::size_t i = 0; i < spec.flag_count(); ++i) {
+        if (spec.flags[i].required && !out.present[i]) return fail(CommandArgs::Status::Usage, spec.flags[i].name);
+    }
+    return true;
+}
+
+void write_usage(std::ostream& os, const CommandSpec& spec) {
+    os << spec.name;
+    for (std::size_t i = 0; i < spec.flag_count(); ++i) {
+        const FlagSpec& f = spec.flags[i];
+        os << (f.required ? " " : " [") << f.name << " " << f.placeholder << (f.required ? "" : "]");
+    }
+}
@@ -0,0 +1,34 @@
+#include "course_dictionary.h"
+
+int CourseDictionary::intern(std::string_view code) {
+    auto it = ids.find(code);
+    if (it != ids.end()) return it->second;
+    int id = static_cast<int>(codes.size());
+    codes.emplace_back(code);
+    ids.emplace(codes.back(), id);
+    return id;
+}
+
+std::optional<int> CourseDictionary::find(std::string_view code) const {
+    auto it = ids.find(code);
+    if (it == ids.end()) return std::nullopt;
+    return it->second;
+}
+
+const std::string& CourseDictionary::code(int id) const {
+    static const std::string unknown;
+    if (id < 0 || static_cast<std::size_t>(id) >= codes.size()) return unknown;
+    return codes[static_cast<std::size_t>(id)];
+}
+
+void CourseDictionary::truncate(std::size_t count) {
+    while (codes.size() > count) {
+        ids.erase(codes.back());
+        codes.pop_back();
+    }
+}
+
+void CourseDictionary::clear() {
+    codes.clear();
+    ids.clear();
+}
@@ -1,42 +1,76 @@
-
 #include "csv.h"
+#include <charconv>
 #include <sstream>
 
 std::vector<std::string> csv::parse_line(const std::string& line) {
-    std::vector<std::string> fields;
-    std::string cur;
-    bool in_quotes = false;
-    for (size_t i = 0; i < line.size(); ++i) {
-        char c = line[i];
-        if (in_quotes) {
-            if (c == '"') {
-                if (i + 1 < line.size() && line[i + 1] == '"') {
-                    cur.push_back('"'); // escaped quote
-                    ++i;
-                } else {
-                    in_quotes = false;
-                }
-            } else {
-                cur.push_back(c);
+    std::vector<std::string_view> views;
+    std::string scratch;
+    if (!parse_line(std::string_view(line), views, scratch)) return {}; // malformed
+    return std::vector<std::string>(views.begin(), views.end());
+}
+
+bool csv::parse_line(std::string_view line, std::vector<std::string_view>& fields, std::string& scratch) {
+    fields.clear();
+    scratch.clear();
+    scratch.reserve(line.size()); // unescaped text is never longer, so views into scratch never move
+    size_t i = 0;
+    while (true) {
+        size_t start = i;
+        // Fast paths: a bare field, or one wrapped in quotes with nothing to unescape.
+        if (i < line.size() && line[i] == '"') {
+            size_t close = line.find('"', i + 1);
+            if (close == std::string_view::npos) return false;
+            if (close + 1 == line.size() || line[close + 1] == ',') {
+                fields.push_back(line.substr(i + 1, close - i - 1));
+                i = close + 1;
+                if (i == line.size()) return true;
+                ++i;
+                continue;
             }
         } else {
-            if (c == ',') {
-                fields.push_back(cur);
-                cur.clear();
+            size_t end = line.find_first_of(",\"", i);
+            if (end == std::string_view::npos) { fields.push_back(line.substr(i)); return true; }
+            if (line[end] == ',') { fields.push_back(line.substr(i, end - i)); i = end + 1; continue; }
+        }
+        // Slow path: replay the quote state machine for this field into scratch.
+        size_t out = scratch.size();
+        bool in_quotes = false;
+        for (i = start; i < line.size(); ++i) {
+            char c = line[i];
+            if (in_quotes) {
+                if (c == '"') {
+                    if (i + 1 < line.size() && line[i + 1] == '"') { scratch.push_back('"'); ++i; } // escaped quote
+                    else in_quotes = false;
+                } else {
+                    scratch.push_back(c);
+                }
+            } else if (c == ',') {
+                break;
             } else if (c == '"') {
                 in_quotes = true;
             } else {
-                cur.push_back(c);
+                scratch.push_back(c);
             }
         }
+        if (in_quotes) return false;
+        fields.push_back(std::string_view(scratch).substr(out));
+        if (i == line.size()) return true;
+        ++i;
     }
-    if (in_quotes) {
-        return {}; // malformed
-    }
-    fields.push_back(cur);
-    return fields;
 }
 
+template <typename T>
+static bool parse_number(std::string_view field, T& out) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\t' || field.back() == '\r')) field.remove_suffix(1);
+    if (field.empty()) return false;
+    auto res = std::from_chars(field.data(), field.data() + field.size(), out);
+    return res.ec == std::errc() && res.ptr == field.data() + field.size();
+}
+
+bool csv::parse_int(std::string_view field, int& out) { return parse_number(field, out); }
+bool csv::parse_size(std::string_view field, std::size_t& out) { return parse_number(field, out); }
+
 std::string csv::escape_field(const std::string& field) {
     bool need_quotes = false;
     for (char c : field) {
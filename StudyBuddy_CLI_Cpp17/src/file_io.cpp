@@ -0,0 +1,195 @@
+#include "file_io.h"
+#include "metrics.h"
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define STUDY_BUDDY_HAVE_MMAP 1
+#define STUDY_BUDDY_HAVE_POSIX_IO 1
+#endif
+
+static LatencyHistogram& fsync_histogram() {
+    static LatencyHistogram& h = Metrics::global().histogram("storage.fsync");
+    return h;
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+#ifdef STUDY_BUDDY_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st{};
+    if (::fstat(fd, &st) == 0) {
+        opened = true;
+        if (st.st_size > 0) {
+            void* p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                ::madvise(p, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+                data = static_cast<const char*>(p);
+                size = static_cast<std::size_t>(st.st_size);
+                mapped = true;
+            } else {
+                opened = false;
+            }
+        }
+    }
+    ::close(fd);
+    if (opened) return;
+#endif
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return;
+    fallback.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    data = fallback.data();
+    size = fallback.size();
+    opened = true;
+}
+
+MappedFile::~MappedFile() { release(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    mapped = other.mapped;
+    opened = other.opened;
+    fallback = std::move(other.fallback);
+    size = other.size;
+    data = mapped ? other.data : fallback.data();
+    other.data = nullptr; other.size = 0; other.mapped = false; other.opened = false;
+    return *this;
+}
+
+void MappedFile::release() {
+#ifdef STUDY_BUDDY_HAVE_MMAP
+    if (mapped) ::munmap(const_cast<char*>(data), size);
+#endif
+    data = nullptr; size = 0; mapped = false; opened = false;
+    fallback.clear();
+}
+
+AppendFile::~AppendFile() { close(); }
+
+bool AppendFile::open(const std::filesystem::path& path) {
+    close();
+    where = path;
+#ifdef STUDY_BUDDY_HAVE_POSIX_IO
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    return fd >= 0;
+#else
+    file = std::fopen(path.string().c_str(), "ab");
+    return file != nullptr;
+#endif
+}
+
+bool AppendFile::write(std::string_view bytes) {
+#ifdef STUDY_BUDDY_HAVE_POSIX_IO
+    while (!bytes.empty()) {
+        ssize_t n = ::write(fd, bytes.data(), bytes.size());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes.remove_prefix(static_cast<std::size_t>(n));
+    }
+    return true;
+#else
+    return std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size() && std::fflush(file) == 0;
+#endif
+}
+
+bool AppendFile::sync() {
+#ifdef STUDY_BUDDY_HAVE_POSIX_IO
+    ScopedTimer timer(fsync_histogram());
+    return ::fsync(fd) == 0;
+#else
+    return std::fflush(file) == 0;
+#endif
+}
+
+bool AppendFile::truncate() {
+#ifdef STUDY_BUDDY_HAVE_POSIX_IO
+    return ::ftruncate(fd, 0) == 0;
+#else
+    std::fclose(file);
+    file = std::fopen(where.string().c_str(), "wb");
+    if (file) std::fclose(file);
+    file = std::fopen(where.string().c_str(), "ab");
+    return file != nullptr;
+#endif
+}
+
+void AppendFile::close() {
+#ifdef STUDY_BUDDY_HAVE_POSIX_IO
+    if (fd >= 0) ::close(fd);
+#endif
+    if (file) std::fclose(file);
+    fd = -1;
+    file = nullptr;
+}
+
+#ifdef STUDY_BUDDY_HAVE_POSIX_IO
+// fsync a directory so a rename inside it survives a crash.
+static bool sync_dir(const std::filesystem::path& dir) {
+    int dfd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dfd < 0) return false;
+    ScopedTimer timer(fsync_histogram());
+    bool ok = ::fsync(dfd) == 0;
+    ::close(dfd);
+    return ok;
+}
+#endif
+
+bool replace_file(const std::filesystem::path& path, std::string_view bytes, bool durable) {
+    std::filesystem::path tmp = path; tmp += ".tmp";
+#ifdef STUDY_BUDDY_HAVE_POSIX_IO
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { std::cerr << "[ERROR] IO_WRITE: cannot open temp for " << path << "\n"; return false; }
+    std::string_view rest = bytes;
+    bool ok = true;
+    while (ok && !rest.empty()) { // one write() unless the kernel returns short
+        ssize_t n = ::write(fd, rest.data(), rest.size());
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) ok = false;
+        else rest.remove_prefix(static_cast<std::size_t>(n));
+    }
+    if (ok && durable) {
+        ScopedTimer timer(fsync_histogram());
+        ok = ::fsync(fd) == 0;
+    }
+    if (::close(fd) != 0) ok = false;
+    if (!ok) {
+        std::cerr << "[ERROR] IO_WRITE: write failed for " << path << "\n";
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    // rename() replaces the target atomically: readers see the old file or the new one.
+    if (::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "[ERROR] IO_RENAME: cannot replace " << path << "\n";
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    if (durable && !sync_dir(path.parent_path())) {
+        std::cerr << "[ERROR] IO_SYNC: cannot fsync directory of " << path << "\n";
+        return false;
+    }
+    return true;
+#else
+    (void)durable; // no portable fsync; the stream is flushed and closed before the rename
+    std::ofstream ofs(tmp, std::ios::binary);
+    if (!ofs) { std::cerr << "[ERROR] IO_WRITE: cannot open temp for " << path << "\n"; return false; }
+    ofs.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    ofs.close();
+    std::error_code ec;
+    if (!ofs) { std::cerr << "[ERROR] IO_WRITE: write failed for " << path << "\n"; std::filesystem::remove(tmp, ec); return false; }
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) { std::cerr << "[ERROR] IO_RENAME: " << ec.message() << "\n"; std::filesystem::remove(tmp, ec); return false; }
+    return true;
+#endif
+}
@@ -1,6 +1,95 @@
-
 #include "cli.h"
-int main() {
-    CLI cli;
-    return cli.run();
+#include "server.h"
+#include "metrics.h"
+#include "trace.h"
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Offline conversion between the CSV tables and the binary snapshot:
+//   study_buddy --export-snapshot [file]   data/*.csv + journal -> file (default data/snapshot.bin)
+//   study_buddy --import-snapshot [file]   file -> data/*.csv
+static int convert_snapshot(const std::string& mode, const std::string& file) {
+    Storage store("data");
+    if (mode == "--export-snapshot") {
+        if (!store.write_snapshot(file) || !store.flush()) return 1;
+        std::cout << "Snapshot written to " << file << "\n";
+        return 0;
+    }
+    if (!store.import_snapshot(file)) { std::cerr << "[ERROR] Cannot import " << file << "\n"; return 1; }
+    if (!store.compact() || !store.flush()) return 1;
+    std::cout << "CSV tables rewritten from " << file << "\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // Leading options, before the mode:
+    //   --durability fsync|periodic|none   when journal appends reach the disk
+    //   --stats-out <file>                 write latency histograms (metrics.h) as JSON on exit
+    //   --trace <file>                     record spans (trace.h) and write a Chrome trace on exit
+    Durability durability = Durability::Periodic;
+    std::string statsOut, traceOut;
+    while (argc >= 3) {
+        std::string opt = argv[1], value = argv[2];
+        if (opt == "--durability") {
+            if (value == "fsync") durability = Durability::Fsync;
+            else if (value == "none") durability = Durability::None;
+            else if (value != "periodic") { std::cerr << "[ERROR] Unknown durability " << value << " (fsync|periodic|none)\n"; return 2; }
+        } else if (opt == "--stats-out") {
+            statsOut = value;
+        } else if (opt == "--trace") {
+            traceOut = value;
+            trace::start();
+        } else {
+            break;
+        }
+        argv += 2;
+        argc -= 2;
+    }
+    auto finish = [&](int rc) {
+        if (!statsOut.empty() && !Metrics::global().write_json(statsOut)) {
+            std::cerr << "[ERROR] Cannot write " << statsOut << "\n";
+            rc = rc ? rc : 1;
+        }
+        if (!traceOut.empty()) {
+            trace::stop();
+            if (!trace::write(traceOut)) { std::cerr << "[ERROR] Cannot write " << traceOut << "\n"; rc = rc ? rc : 1; }
+            if (trace::dropped() > 0) {
+                std::cerr << "Warning: trace kept the first " << trace::span_limit() << " spans; "
+                          << trace::dropped() << " later ones were dropped\n";
+            }
+        }
+        return rc;
+    };
+
+    if (argc >= 2) {
+        std::string mode = argv[1];
+        if (mode == "--export-snapshot" || mode == "--import-snapshot") {
+            return finish(convert_snapshot(mode, argc >= 3 ? argv[2] : "data/snapshot.bin"));
+        }
+        // study_buddy --serve [socket]     one process owns data/ and serves many clients
+        // study_buddy --connect [socket]   talk to it (commands from stdin, as interactively)
+        if (mode == "--serve" || mode == "--connect") {
+            std::string socket = argc >= 3 ? argv[2] : "data/study_buddy.sock";
+            if (mode == "--connect") return run_client(socket);
+            CLI cli("data", durability);
+            Server server(cli, socket);
+            return finish(server.run(true));
+        }
+        // study_buddy --batch <file|->   run a command script without prompts
+        if (mode == "--batch" && argc >= 3) {
+            std::string file = argv[2];
+            CLI cli("data", durability);
+            if (file == "-") return finish(cli.run_batch(std::cin));
+            std::ifstream in(file);
+            if (!in) { std::cerr << "[ERROR] Cannot open " << file << "\n"; return 2; }
+            return finish(cli.run_batch(in));
+        }
+        std::cerr << "Usage: study_buddy [--durability fsync|periodic|none] [--stats-out <file>] [--trace <file>] [--batch <file|-> | --serve [socket]]\n"
+                  << "       study_buddy --connect [socket]\n"
+                  << "       study_buddy --export-snapshot [file] | --import-snapshot [file]\n";
+        return 2;
+    }
+    CLI cli("data", durability);
+    return finish(cli.run());
 }
@@ -0,0 +1,102 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+void LatencyHistogram::record(std::uint64_t ns) noexcept {
+    std::size_t bucket = 63 - static_cast<std::size_t>(__builtin_clzll(ns | 1));
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(ns, std::memory_order_relaxed);
+    std::uint64_t seen = max.load(std::memory_order_relaxed);
+    while (ns > seen && !max.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {}
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot s;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        s.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        s.count += s.buckets[i];
+    }
+    s.sum_ns = sum.load(std::memory_order_relaxed);
+    s.max_ns = max.load(std::memory_order_relaxed);
+    return s;
+}
+
+std::uint64_t LatencyHistogram::Snapshot::percentile_ns(double p) const {
+    if (count == 0) return 0;
+    auto rank = static_cast<std::uint64_t>(std::ceil(p / 100.0 * static_cast<double>(count)));
+    rank = std::max<std::uint64_t>(1, std::min(rank, count));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            std::uint64_t upper = i >= 63 ? max_ns : (std::uint64_t{2} << i) - 1;
+            return std::min(upper, max_ns);
+        }
+    }
+    return max_ns;
+}
+
+Metrics& Metrics::global() {
+    static Metrics instance;
+    return instance;
+}
+
+LatencyHistogram& Metrics::histogram(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto& e : entries) {
+        if (e.first == name) return *e.second;
+    }
+    entries.emplace_back(name, std::make_unique<LatencyHistogram>());
+    return *entries.back().second;
+}
+
+std::vector<std::pair<std::string, LatencyHistogram::Snapshot>> Metrics::snapshot() const {
+    std::vector<std::pair<std::string, LatencyHistogram::Snapshot>> out;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        out.reserve(entries.size());
+        for (const auto& e : entries) out.emplace_back(e.first, e.second->snapshot());
+    }
+    std::sort(out.begin(), out.end(), [](const auto& a, const auto& b){ return a.first < b.first; });
+    return out;
+}
+
+void Metrics::print(std::ostream& os) const {
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-24s %8s %10s %10s %10s %10s %10s\n", "name", "count", "mean_us", "p50_us", "p90_us", "p99_us", "max_us");
+    os << line;
+    bool any = false;
+    for (const auto& [name, s] : snapshot()) {
+        if (s.count == 0) continue;
+        any = true;
+        std::snprintf(line, sizeof(line), "%-24s %8llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", name.c_str(),
+                      static_cast<unsigned long long>(s.count), s.mean_ns() / 1e3, s.percentile_ns(50) / 1e3,
+                      s.percentile_ns(90) / 1e3, s.percentile_ns(99) / 1e3, s.max_ns / 1e3);
+        os << line;
+    }
+    if (!any) os << "(no samples yet)\n";
+}
+
+bool Metrics::write_json(const std::filesystem::path& path) const {
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (!ofs) return false;
+    ofs << "{\"histograms\":[";
+    bool first = true;
+    for (const auto& [name, s] : snapshot()) {
+        if (s.count == 0) continue;
+        ofs << (first ? "" : ",") << "\n  {\"name\":\"" << name << "\",\"count\":" << s.count
+            << ",\"sum_ns\":" << s.sum_ns << ",\"max_ns\":" << s.max_ns
+            << ",\"p50_ns\":" << s.percentile_ns(50) << ",\"p90_ns\":" << s.percentile_ns(90)
+            << ",\"p99_ns\":" << s.percentile_ns(99) << ",\"buckets\":[";
+        // Trailing empty buckets are omitted; bucket i covers [2^i, 2^(i+1)) ns.
+        std::size_t last = LatencyHistogram::kBuckets;
+        while (last > 0 && s.buckets[last - 1] == 0) --last;
+        for (std::size_t i = 0; i < last; ++i) ofs << (i ? "," : "") << s.buckets[i];
+        ofs << "]}";
+        first = false;
+    }
+    ofs << "\n]}\n";
+    return static_cast<bool>(ofs);
+}
@@ -0,0 +1,181 @@
+#include "persistence.h"
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+#include <iostream>
+
+// Longest a written journal record stays unsynced in Periodic mode.
+static constexpr std::chrono::milliseconds kSyncPeriod{1000};
+
+PersistenceWorker::PersistenceWorker(std::filesystem::path journal_path, Durability mode)
+    : journalPath(std::move(journal_path)), durability(mode), lastSync(std::chrono::steady_clock::now()) {
+    thread = std::thread([this]{ run(); });
+}
+
+PersistenceWorker::~PersistenceWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+std::uint64_t PersistenceWorker::enqueue(Job job) {
+    std::uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        jobs.push_back(std::move(job));
+        ticket = ++queued;
+    }
+    wake.notify_one();
+    return ticket;
+}
+
+bool PersistenceWorker::wait_for(std::uint64_t ticket) {
+    std::unique_lock<std::mutex> lock(mtx);
+    finished.wait(lock, [&]{ return completed >= ticket; });
+    for (const auto& r : failedRanges) {
+        if (r.first <= ticket && ticket <= r.second) return false;
+    }
+    return true;
+}
+
+bool PersistenceWorker::append(std::string lines) {
+    std::uint64_t ticket = enqueue(Job{JobKind::Append, {}, std::move(lines)});
+    if (durability != Durability::Fsync && !journalFailing.load()) return true;
+    return wait_for(ticket);
+}
+
+void PersistenceWorker::replace(std::filesystem::path path, std::string bytes) {
+    enqueue(Job{JobKind::Replace, std::move(path), std::move(bytes)});
+}
+
+void PersistenceWorker::truncate_journal(bool rewroteAll) {
+    enqueue(Job{JobKind::Truncate, {}, {}, rewroteAll});
+}
+
+std::vector<std::filesystem::path> PersistenceWorker::failed_replaces() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return failedReplaces;
+}
+
+bool PersistenceWorker::appends_lost() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return appendsLost;
+}
+
+bool PersistenceWorker::drain() {
+    std::unique_lock<std::mutex> lock(mtx);
+    std::uint64_t ticket = queued;
+    finished.wait(lock, [&]{ return completed >= ticket; });
+    bool ok = failedRanges.empty();
+    failedRanges.clear();
+    return ok;
+}
+
+bool PersistenceWorker::write_journal(const std::string& bytes) {
+    if (!journal.is_open() && !journal.open(journalPath)) {
+        std::cerr << "[ERROR] IO_WRITE: cannot open " << journalPath << "\n";
+        journalFailing = true;
+        return false;
+    }
+    static LatencyHistogram& appendHist = Metrics::global().histogram("journal.append");
+    ScopedTimer timer(appendHist);
+    TRACE_SCOPE("journal append", "io");
+    unsynced = true;
+    if (journal.write(bytes)) { journalFailing = false; return true; }
+    std::cerr << "[ERROR] IO_WRITE: journal append failed\n";
+    journal.close();
+    journalFailing = true;
+    return false;
+}
+
+bool PersistenceWorker::sync_journal() {
+    if (!unsynced || !journal.is_open()) return true;
+    TRACE_SCOPE("journal fsync", "io");
+    unsynced = false;
+    lastSync = std::chrono::steady_clock::now();
+    if (journal.sync()) return true;
+    std::cerr << "[ERROR] IO_SYNC: cannot fsync " << journalPath << "\n";
+    return false;
+}
+
+void PersistenceWorker::run() {
+    while (true) {
+        std::deque<Job> batch;
+        std::uint64_t first;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            auto ready = [this]{ return stopping || !jobs.empty(); };
+            if (durability == Durability::Periodic && unsynced) wake.wait_until(lock, lastSync + kSyncPeriod, ready);
+            else wake.wait(lock, ready);
+            if (jobs.empty() && stopping) break;
+            batch.swap(jobs);
+            first = completed + 1;
+        }
+
+        // Consecutive appends are concatenated so the whole group is one write().
+        bool ok = true;
+        std::string pending;
+        auto flush_pending = [&]{
+            if (pending.empty()) return;
+            if (!write_journal(pending)) {
+                ok = false;
+                std::lock_guard<std::mutex> lock(mtx);
+                appendsLost = true;
+            }
+            pending.clear();
+        };
+        for (auto& job : batch) {
+            switch (job.kind) {
+            case JobKind::Append:
+                pending += job.bytes;
+                break;
+            case JobKind::Replace: {
+                flush_pending();
+                TRACE_SCOPE("replace_file", "io");
+                bool written = replace_file(job.path, job.bytes, durability != Durability::None);
+                ok = written && ok;
+                std::lock_guard<std::mutex> lock(mtx);
+                auto known = std::find(failedReplaces.begin(), failedReplaces.end(), job.path);
+                if (written && known != failedReplaces.end()) failedReplaces.erase(known);
+                else if (!written && known == failedReplaces.end()) failedReplaces.push_back(job.path);
+                break;
+            }
+            case JobKind::Truncate: {
+                flush_pending();
+                bool keep;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (job.rewroteAll && failedReplaces.empty()) appendsLost = false;
+                    keep = !failedReplaces.empty() || appendsLost;
+                }
+                if (keep) {
+                    std::cerr << "[ERROR] IO_WRITE: keeping " << journalPath << " after a failed write\n";
+                    ok = false;
+                    break;
+                }
+                if (!journal.is_open() && !journal.open(journalPath)) { ok = false; break; }
+                unsynced = true;
+                if (!journal.truncate()) {
+                    std::cerr << "[ERROR] IO_WRITE: cannot truncate " << journalPath << "\n";
+                    ok = false;
+                }
+                break;
+            }
+            }
+        }
+        flush_pending();
+        bool due = std::chrono::steady_clock::now() - lastSync >= kSyncPeriod;
+        if (durability == Durability::Fsync || (durability == Durability::Periodic && due)) ok = sync_journal() && ok;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            completed += batch.size();
+            if (!ok && !batch.empty()) failedRanges.push_back({first, completed});
+        }
+        finished.notify_all();
+    }
+    if (durability != Durability::None) sync_journal();
+}
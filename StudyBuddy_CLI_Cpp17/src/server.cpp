@@ -0,0 +1,256 @@
+#include "server.h"
+#include "string_utils.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define STUDY_BUDDY_HAVE_UNIX_SOCKETS 1
+#endif
+
+#ifdef STUDY_BUDDY_HAVE_UNIX_SOCKETS
+
+// How often the accept loop wakes to check for stop() or a signal.
+static constexpr int kAcceptPollMs = 200;
+// Longest request line a connection may send (and reply header it may receive).
+static constexpr std::size_t kMaxLineBytes = 16 * 1024;
+
+static volatile std::sig_atomic_t gSignalled = 0;
+static void on_signal(int) { gSignalled = 1; }
+
+static bool write_all(int fd, std::string_view bytes) {
+    while (!bytes.empty()) {
+        ssize_t n = ::write(fd, bytes.data(), bytes.size());
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes.remove_prefix(static_cast<std::size_t>(n));
+    }
+    return true;
+}
+
+// Read until `buf` holds at least `want` bytes; false on EOF or error.
+static bool fill(int fd, std::string& buf, std::size_t want) {
+    char chunk[4096];
+    while (buf.size() < want) {
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf.append(chunk, static_cast<std::size_t>(n));
+    }
+    return true;
+}
+
+enum class LineRead { Ok, Closed, TooLong };
+
+// Next '\n'-terminated line from fd, using `buf` for bytes read past it. TooLong once
+// kMaxLineBytes arrive without a newline, so a peer cannot grow `buf` without bound.
+static LineRead read_line(int fd, std::string& buf, std::string& line) {
+    std::size_t scanned = 0, nl;
+    while ((nl = buf.find('\n', scanned)) == std::string::npos) {
+        if (buf.size() > kMaxLineBytes) return LineRead::TooLong;
+        scanned = buf.size();
+        if (!fill(fd, buf, buf.size() + 1)) return LineRead::Closed;
+    }
+    if (nl > kMaxLineBytes) return LineRead::TooLong;
+    line.assign(buf, 0, nl);
+    buf.erase(0, nl + 1);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    return LineRead::Ok;
+}
+
+static bool make_address(const std::string& path, sockaddr_un& addr) {
+    addr = sockaddr_un{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    std::copy(path.begin(), path.end(), addr.sun_path);
+    return true;
+}
+
+#endif
+
+Server::Server(CLI& c, std::string socket_path): cli(c), socketPath(std::move(socket_path)) {}
+
+Server::~Server() {
+    stop();
+    for (auto& w : workers) if (w.joinable()) w.join();
+}
+
+int Server::run(bool foreground) {
+#ifdef STUDY_BUDDY_HAVE_UNIX_SOCKETS
+    std::signal(SIGPIPE, SIG_IGN); // a client hanging up must not kill the daemon
+    if (foreground) {
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+    }
+    sockaddr_un addr;
+    if (!make_address(socketPath, addr)) { std::cerr << "[ERROR] Socket path too long: " << socketPath << "\n"; return 1; }
+    {
+        // Refuse to take over the socket of a daemon that is still running.
+        ServerConnection probe;
+        if (probe.open(socketPath)) { std::cerr << "[ERROR] A server is already listening on " << socketPath << "\n"; return 1; }
+    }
+    int lfd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0) { std::cerr << "[ERROR] Cannot create socket\n"; return 1; }
+    ::unlink(socketPath.c_str()); // stale socket from a previous run
+    if (::bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(lfd, 64) != 0) {
+        std::cerr << "[ERROR] Cannot listen on " << socketPath << "\n";
+        ::close(lfd);
+        return 1;
+    }
+    if (foreground) std::cout << "Serving " << cli.storage().dataDir.string() << " on " << socketPath << " (Ctrl-C to stop)" << std::endl;
+
+    while (!stopping && !gSignalled) {
+        pollfd pfd{lfd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, kAcceptPollMs);
+        {
+            // Join connection threads that have finished since the last wakeup.
+            std::lock_guard<std::mutex> lock(connMtx);
+            for (auto it = workers.begin(); it != workers.end(); ) {
+                if (std::find(finishedWorkers.begin(), finishedWorkers.end(), it->get_id()) == finishedWorkers.end()) { ++it; continue; }
+                it->join();
+                it = workers.erase(it);
+            }
+            finishedWorkers.clear();
+        }
+        if (ready <= 0) continue;
+        int fd = ::accept(lfd, nullptr, nullptr);
+        if (fd < 0) continue;
+        std::lock_guard<std::mutex> lock(connMtx);
+        connFds.push_back(fd);
+        workers.emplace_back(&Server::serve, this, fd);
+    }
+
+    ::close(lfd);
+    ::unlink(socketPath.c_str());
+    {
+        // Wake every connection blocked in read(); each thread then closes its socket.
+        std::lock_guard<std::mutex> lock(connMtx);
+        for (int fd : connFds) ::shutdown(fd, SHUT_RDWR);
+    }
+    for (auto& w : workers) w.join();
+    workers.clear();
+
+    Storage& store = cli.storage();
+    auto lock = store.write_lock();
+    if (store.journalRecords > 0) store.compact();
+    if (!store.flush()) { std::cerr << "[ERROR] IO_WRITE: some changes could not be written to disk\n"; return 1; }
+    return 0;
+#else
+    (void)foreground;
+    std::cerr << "[ERROR] Server mode needs Unix domain sockets\n";
+    return 1;
+#endif
+}
+
+void Server::serve(int fd) {
+#ifdef STUDY_BUDDY_HAVE_UNIX_SOCKETS
+    CLI::Client client;
+    std::string buf, line;
+    while (client.running) {
+        LineRead got = read_line(fd, buf, line);
+        if (got == LineRead::TooLong) {
+            // The rest of the line cannot be told apart from the next request: reply and hang up.
+            const std::string err = "[ERROR] LINE_TOO_LONG\n";
+            write_all(fd, "0 0 " + std::to_string(err.size()) + "\n" + err);
+            break;
+        }
+        if (got != LineRead::Ok) break;
+        std::ostringstream out, errs;
+        client.out = &out;
+        client.errs = &errs;
+        line = trim(line);
+        bool ok = true;
+        if (!line.empty()) {
+            // Read commands from different connections run concurrently (see CLI::run_command).
+            ok = cli.run_command(client, line);
+            if (!CLI::is_read_command(command_name(line))) {
+                auto lock = cli.storage().write_lock();
+                cli.storage().maybe_compact();
+            }
+        }
+        std::string o = out.str(), e = errs.str();
+        std::string reply = (ok ? "1 " : "0 ") + std::to_string(o.size()) + " " + std::to_string(e.size()) + "\n";
+        if (!write_all(fd, reply + o + e)) break;
+    }
+    std::lock_guard<std::mutex> lock(connMtx);
+    connFds.erase(std::remove(connFds.begin(), connFds.end(), fd), connFds.end());
+    ::close(fd);
+    finishedWorkers.push_back(std::this_thread::get_id());
+#else
+    (void)fd;
+#endif
+}
+
+ServerConnection::~ServerConnection() { close(); }
+
+bool ServerConnection::open(const std::string& socket_path) {
+    close();
+#ifdef STUDY_BUDDY_HAVE_UNIX_SOCKETS
+    sockaddr_un addr;
+    if (!make_address(socket_path, addr)) return false;
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) { close(); return false; }
+    return true;
+#else
+    (void)socket_path;
+    return false;
+#endif
+}
+
+bool ServerConnection::request(const std::string& line, std::string& out, std::string& err, bool& ok) {
+#ifdef STUDY_BUDDY_HAVE_UNIX_SOCKETS
+    if (fd < 0 || !write_all(fd, line + "\n")) return false;
+    std::string header;
+    if (read_line(fd, pending, header) != LineRead::Ok) return false;
+    int status = 0;
+    unsigned long long outLen = 0, errLen = 0;
+    if (std::sscanf(header.c_str(), "%d %llu %llu", &status, &outLen, &errLen) != 3) return false;
+    if (!fill(fd, pending, outLen + errLen)) return false;
+    out.assign(pending, 0, outLen);
+    err.assign(pending, outLen, errLen);
+    pending.erase(0, outLen + errLen);
+    ok = status == 1;
+    return true;
+#else
+    (void)line; (void)out; (void)err; (void)ok;
+    return false;
+#endif
+}
+
+void ServerConnection::close() {
+#ifdef STUDY_BUDDY_HAVE_UNIX_SOCKETS
+    if (fd >= 0) ::close(fd);
+#endif
+    fd = -1;
+    pending.clear();
+}
+
+int run_client(const std::string& socket_path) {
+    ServerConnection conn;
+    if (!conn.open(socket_path)) { std::cerr << "[ERROR] Cannot connect to " << socket_path << "\n"; return 2; }
+#ifdef STUDY_BUDDY_HAVE_UNIX_SOCKETS
+    bool prompt = ::isatty(0);
+#else
+    bool prompt = false;
+#endif
+    std::string line, out, err;
+    bool ok;
+    while (true) {
+        if (prompt) std::cout << "> " << std::flush;
+        if (!std::getline(std::cin, line)) break;
+        if (!conn.request(line, out, err, ok)) { std::cerr << "[ERROR] Connection to server lost\n"; return 1; }
+        std::cout << out << std::flush;
+        std::cerr << err;
+        if (trim(line) == "exit") break;
+    }
+    return 0;
+}
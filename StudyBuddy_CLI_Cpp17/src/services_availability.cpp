@@ -7,9 +7,10 @@
 
 bool AvailabilityService::add_availability(int student_id, int day, int start, int end, std::string& err) {
     if (!is_valid_day(day) || !is_valid_avail_range(start, end)) { err = "BAD_RANGE"; return false; }
+    auto& mine = store.availabilityByStudent[student_id];
     // Collect existing slots for same student/day
     std::vector<Availability> slots;
-    for (const auto& a : store.availability) if (a.student_id == student_id && a.day == day) slots.push_back(a);
+    for (const auto& a : mine) if (a.day == day) slots.push_back(a);
     // Add new slot
     slots.push_back(Availability{student_id, day, start, end});
     // Sort by start
@@ -23,33 +24,43 @@ bool AvailabilityService::add_availability(int student_id, int day, int start, i
             merged.back().end = std::max(merged.back().end, cur.end);
         }
     }
-    // Remove old entries for that student/day
-    store.availability.erase(std::remove_if(store.availability.begin(), store.availability.end(),
-        [&](const Availability& a){ return a.student_id == student_id && a.day == day; }), store.availability.end());
+    // Remove old entries for that student/day; the removals and merged slots are journaled together.
+    Storage::Transaction txn(store);
+    store.undo_availability(student_id);
+    for (const auto& a : mine) if (a.day == day) store.journal_availability(a, false);
+    mine.erase(std::remove_if(mine.begin(), mine.end(),
+        [&](const Availability& a){ return a.day == day; }), mine.end());
     // Append merged
-    store.availability.insert(store.availability.end(), merged.begin(), merged.end());
-    store.save_availability();
+    mine.insert(mine.end(), merged.begin(), merged.end());
+    for (const auto& a : merged) store.journal_availability(a, true);
+    // Merging only ever grows coverage, so the bitmap is just the union with the new range.
+    set_hours(store.availabilityMasks[student_id], day, start, end);
+    if (!txn.commit()) { err = "IO_WRITE"; return false; }
     return true;
 }
 
 bool AvailabilityService::remove_availability_exact(int student_id, int day, int start, int end, std::string& msg) {
-    bool removed = false;
-    auto it = std::remove_if(store.availability.begin(), store.availability.end(),
-        [&](const Availability& a){ 
-            if (a.student_id == student_id && a.day == day && a.start == start && a.end == end) { removed = true; return true; }
-            return false;
-        });
-    if (it != store.availability.end()) {
-        store.availability.erase(it, store.availability.end());
-        store.save_availability();
+    auto found = store.availabilityByStudent.find(student_id);
+    if (found == store.availabilityByStudent.end()) { msg = "No matching slot found"; return false; }
+    auto& mine = found->second;
+    auto same = [&](const Availability& a){ return a.day == day && a.start == start && a.end == end; };
+    if (std::none_of(mine.begin(), mine.end(), same)) { msg = "No matching slot found"; return false; }
+    Storage::Transaction txn(store);
+    store.undo_availability(student_id);
+    mine.erase(std::remove_if(mine.begin(), mine.end(), same), mine.end());
+    store.journal_availability(Availability{student_id, day, start, end}, false);
+    // Clear the removed hours, then restore any that another slot on that day still covers.
+    WeekMask& mask = store.availabilityMasks[student_id];
+    set_hours(mask, day, start, end, false);
+    for (const auto& a : mine) {
+        if (a.day == day) set_hours(mask, a.day, a.start, a.end);
     }
-    if (!removed) { msg = "No matching slot found"; }
-    return removed;
+    if (!txn.commit()) { msg = "IO_WRITE"; return false; }
+    return true;
 }
 
 std::vector<Availability> AvailabilityService::list_availability(int student_id) const {
-    std::vector<Availability> out;
-    for (const auto& a : store.availability) if (a.student_id == student_id) out.push_back(a);
+    std::vector<Availability> out = store.availability_of(student_id);
     std::sort(out.begin(), out.end(), [](const Availability& x, const Availability& y){
         if (x.day != y.day) return x.day < y.day;
         return x.start < y.start;
@@ -58,8 +69,8 @@ std::vector<Availability> AvailabilityService::list_availability(int student_id)
 }
 
 bool AvailabilityService::within_availability(int student_id, int day, int start, int end) const {
-    for (const auto& a : store.availability) {
-        if (a.student_id == student_id && a.day == day) {
+    for (const auto& a : store.availability_of(student_id)) {
+        if (a.day == day) {
             if (a.start <= start && end <= a.end) return true;
         }
     }
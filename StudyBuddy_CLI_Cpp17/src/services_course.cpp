@@ -3,58 +3,51 @@
 #include "validation.h"
 #include <algorithm>
 
-bool CourseService::add_course(int student_id, const std::string& course_code, std::string& err) {
+bool CourseService::add_course(int student_id, std::string_view course_code, std::string& err) {
     if (!is_valid_course(course_code)) { err = "BAD_COURSE"; return false; }
-    // duplicate check
-    for (const auto& e : store.enrollments) {
-        if (e.student_id == student_id && e.course_code == course_code) {
-            err = "DUP_COURSE"; return false;
-        }
-    }
-    Enrollment e{student_id, course_code};
-    store.enrollments.push_back(e);
-    store.enrollmentsByCourse.emplace(course_code, student_id);
-    store.save_enrollments();
+    if (enrolled(student_id, course_code)) { err = "DUP_COURSE"; return false; }
+    // Interned inside the transaction, so a failed add does not leave the code behind.
+    Storage::Transaction txn(store);
+    Enrollment e{student_id, store.courses.intern(course_code)};
+    store.add_enrollment(e);
+    store.journal_enrollment(e, true);
+    if (!txn.commit()) { err = "IO_WRITE"; return false; }
     return true;
 }
 
-bool CourseService::remove_course(int student_id, const std::string& course_code, std::string& err) {
-    // check sessions not cancelled
-    for (const auto& kv : store.sessions) {
-        const auto& s = kv.second;
-        if (s.course_code != course_code) continue;
+bool CourseService::remove_course(int student_id, std::string_view course_code, std::string& err) {
+    auto course_id = store.courses.find(course_code);
+    if (!course_id) { err = "COURSE_NOT_ENROLLED"; return false; }
+    // check sessions not cancelled (only the ones this student organizes or joined)
+    for (int sid : store.sessions_of(student_id)) {
+        auto it = store.sessions.find(sid);
+        if (it == store.sessions.end()) continue;
+        const auto& s = it->second;
+        if (s.course_id != *course_id) continue;
         if (s.status == SessionStatus::CANCELLED) continue;
-        bool involved = (s.organizer_id == student_id);
-        if (!involved) {
-            for (const auto& p : store.participants) {
-                if (p.session_id == s.id && p.student_id == student_id) { involved = true; break; }
-            }
-        }
-        if (involved) { err = "SESSIONS_EXIST"; return false; }
+        err = "SESSIONS_EXIST"; return false;
     }
-    // erase enrollment
-    bool removed = false;
-    store.enrollments.erase(std::remove_if(store.enrollments.begin(), store.enrollments.end(),
-        [&](const Enrollment& e){ 
-            if (e.student_id == student_id && e.course_code == course_code) { removed = true; return true; }
-            return false;
-        }), store.enrollments.end());
-    if (!removed) { err = "COURSE_NOT_ENROLLED"; return false; }
-
-    // rebuild enrollmentsByCourse (simple & safe)
-    store.recompute_indices();
-    store.save_enrollments();
+    if (!enrolled(student_id, *course_id)) { err = "COURSE_NOT_ENROLLED"; return false; }
+    Storage::Transaction txn(store);
+    store.remove_enrollment(student_id, *course_id);
+    store.journal_enrollment(Enrollment{student_id, *course_id}, false);
+    if (!txn.commit()) { err = "IO_WRITE"; return false; }
     return true;
 }
 
 std::vector<std::string> CourseService::list_courses(int student_id) const {
     std::vector<std::string> out;
-    for (const auto& e : store.enrollments) if (e.student_id == student_id) out.push_back(e.course_code);
+    for (const auto& e : store.enrollments_of(student_id)) out.push_back(store.courses.code(e.course_id));
     std::sort(out.begin(), out.end());
     return out;
 }
 
-bool CourseService::enrolled(int student_id, const std::string& course_code) const {
-    for (const auto& e : store.enrollments) if (e.student_id == student_id && e.course_code == course_code) return true;
+bool CourseService::enrolled(int student_id, std::string_view course_code) const {
+    auto course_id = store.courses.find(course_code);
+    return course_id && enrolled(student_id, *course_id);
+}
+
+bool CourseService::enrolled(int student_id, int course_id) const {
+    for (const auto& e : store.enrollments_of(student_id)) if (e.course_id == course_id) return true;
     return false;
 }
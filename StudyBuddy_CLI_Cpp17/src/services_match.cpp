@@ -1,56 +1,74 @@
 
 #include "services_match.h"
+#include "thread_pool.h"
+#include "trace.h"
 #include "validation.h"
 #include <algorithm>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <queue>
 
-static bool overlap_pair(int s1, int e1, int s2, int e2, int& out_s, int& out_e) {
-    out_s = std::max(s1, s2);
-    out_e = std::min(e1, e2);
-    return out_s < out_e;
+// Turn a weekly overlap bitmap into (day, [hours]) runs, in day/hour order.
+static std::vector<std::pair<int, std::vector<int>>> overlap_runs(const WeekMask& both) {
+    std::vector<std::pair<int, std::vector<int>>> runs;
+    for (int d = 0; d < kDaysPerWeek; ++d) {
+        std::vector<int> hours;
+        for (int h = 0; h <= kHoursPerDay; ++h) {
+            if (h < kHoursPerDay && both.test(week_bit(d, h))) { hours.push_back(h); continue; }
+            if (!hours.empty()) { runs.push_back({d, hours}); hours.clear(); }
+        }
+    }
+    return runs;
 }
 
-std::vector<MatchCandidate> MatchService::suggest_matches(int student_id, const std::string& course_code, std::string& err) const {
+// Smallest classmate slice worth a pool task in suggest_matches.
+static constexpr std::size_t kMatchSliceMin = 128;
+
+std::vector<MatchCandidate> MatchService::suggest_matches(int student_id, std::string_view course_code, std::string& err) const {
+    TRACE_SCOPE("MatchService::suggest_matches", "match");
     std::vector<MatchCandidate> result;
     if (!is_valid_course(course_code)) { err = "BAD_COURSE"; return result; }
-    if (!courseSvc.enrolled(student_id, course_code)) { err = "NOT_ENROLLED"; return result; }
+    auto course_id = store.courses.find(course_code);
+    if (!course_id || !courseSvc.enrolled(student_id, *course_id)) { err = "NOT_ENROLLED"; return result; }
 
-    // Build my slots by day
-    std::vector<Availability> my;
-    for (const auto& a : store.availability) if (a.student_id == student_id) my.push_back(a);
+    const WeekMask& my = store.availability_mask(student_id);
 
     // Classmates
     std::vector<int> others;
-    auto range = store.enrollmentsByCourse.equal_range(course_code);
-    for (auto it = range.first; it != range.second; ++it) {
-        if (it->second != student_id) others.push_back(it->second);
+    for (int mate_id : store.students_in(*course_id)) {
+        if (mate_id != student_id) others.push_back(mate_id);
     }
     std::sort(others.begin(), others.end());
     others.erase(std::unique(others.begin(), others.end()), others.end());
 
-    for (int mate_id : others) {
-        std::vector<Availability> mate;
-        for (const auto& a : store.availability) if (a.student_id == mate_id) mate.push_back(a);
-        std::vector<std::pair<int, std::vector<int>>> candidates; // (day, [hours])
-
-        for (const auto& m1 : my) {
-            for (const auto& m2 : mate) {
-                if (m1.day != m2.day) continue;
-                int s,e;
-                if (overlap_pair(m1.start, m1.end, m2.start, m2.end, s, e)) {
-                    std::vector<int> hours;
-                    for (int h = s; h < e && h <= 23; ++h) hours.push_back(h);
-                    if (!hours.empty()) candidates.push_back({m1.day, hours});
-                }
-            }
+    auto scan = [&](std::size_t lo, std::size_t hi) {
+        std::vector<MatchCandidate> found;
+        for (std::size_t i = lo; i < hi; ++i) {
+            int mate_id = others[i];
+            WeekMask both = my & store.availability_mask(mate_id);
+            if (both.none()) continue;
+            found.push_back(MatchCandidate{mate_id, store.students.at(mate_id).name, overlap_runs(both)});
+        }
+        return found;
+    };
+    if (others.size() < parallelThreshold) {
+        result = scan(0, others.size());
+    } else {
+        // Slices of the id-sorted classmate list go to the pool; concatenating them in
+        // slice order rebuilds exactly the sequential list before the sort below.
+        ThreadPool& pool = ThreadPool::shared();
+        std::size_t slice = std::max<std::size_t>(kMatchSliceMin, others.size() / (pool.size() * 4) + 1);
+        std::vector<std::future<std::vector<MatchCandidate>>> parts;
+        for (std::size_t lo = 0; lo < others.size(); lo += slice) {
+            parts.push_back(pool.submit([&, lo]{
+                TRACE_SCOPE("match slice", "match");
+                return scan(lo, std::min(others.size(), lo + slice));
+            }));
         }
-        if (!candidates.empty()) {
-            std::sort(candidates.begin(), candidates.end(), [](auto& a, auto& b){
-                if (a.first != b.first) return a.first < b.first;
-                return (!a.second.empty() && !b.second.empty()) ? a.second.front() < b.second.front() : a.second.size() < b.second.size();
-            });
-            MatchCandidate mc{mate_id, store.students.at(mate_id).name, candidates};
-            result.push_back(std::move(mc));
+        for (auto& p : parts) {
+            auto found = p.get();
+            result.insert(result.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
         }
     }
 
@@ -62,3 +80,146 @@ std::vector<MatchCandidate> MatchService::suggest_matches(int student_id, const
     });
     return result;
 }
+
+// First set bit of a non-empty mask, i.e. the earliest shared hour of the week.
+static int first_hour(const WeekMask& m) {
+    int h = 0;
+    while (h < kHoursPerWeek && !m.test(static_cast<std::size_t>(h))) ++h;
+    return h;
+}
+
+std::vector<MatchCandidate> MatchService::top_matches(int student_id, std::string_view course_code, std::size_t k,
+                                                      IdSpan preferred_days, int preferred_weight, std::string& err) const {
+    TRACE_SCOPE("MatchService::top_matches", "match");
+    std::vector<MatchCandidate> result;
+    if (!is_valid_course(course_code)) { err = "BAD_COURSE"; return result; }
+    auto course_id = store.courses.find(course_code);
+    if (!course_id || !courseSvc.enrolled(student_id, *course_id)) { err = "NOT_ENROLLED"; return result; }
+    if (preferred_weight < 1) { err = "BAD_WEIGHT"; return result; }
+    WeekMask preferred;
+    for (int d : preferred_days) {
+        if (!is_valid_day(d)) { err = "BAD_DAY"; return result; }
+        set_hours(preferred, d, 0, kHoursPerDay);
+    }
+    if (k == 0) return result;
+
+    struct Ranked { int score; int first; int id; };
+    // "better" orders best first; as the heap comparator it keeps the worst kept candidate on top.
+    auto better = [&](const Ranked& a, const Ranked& b) {
+        if (a.score != b.score) return a.score > b.score;
+        if (a.first != b.first) return a.first < b.first;
+        const std::string& an = store.students.at(a.id).name;
+        const std::string& bn = store.students.at(b.id).name;
+        if (an != bn) return an < bn;
+        return a.id < b.id;
+    };
+    std::priority_queue<Ranked, std::vector<Ranked>, decltype(better)> heap(better);
+
+    const WeekMask& my = store.availability_mask(student_id);
+    for (int mate_id : store.students_in(*course_id)) {
+        if (mate_id == student_id) continue;
+        WeekMask both = my & store.availability_mask(mate_id);
+        if (both.none()) continue;
+        int score = static_cast<int>(both.count()) + (preferred_weight - 1) * static_cast<int>((both & preferred).count());
+        Ranked r{score, first_hour(both), mate_id};
+        if (heap.size() < k) heap.push(r);
+        else if (better(r, heap.top())) { heap.pop(); heap.push(r); }
+    }
+
+    result.resize(heap.size());
+    for (auto slot = result.rbegin(); slot != result.rend(); ++slot) {
+        const Ranked& r = heap.top();
+        *slot = MatchCandidate{r.id, store.students.at(r.id).name,
+                               overlap_runs(my & store.availability_mask(r.id)), r.score};
+        heap.pop();
+    }
+    return result;
+}
+
+// Rows per pool task for overlap_matrix; small enough to balance the triangular workload.
+static constexpr std::size_t kMatrixRowBlock = 64;
+
+MatchMatrix MatchService::overlap_matrix(std::string_view course_code, std::string& err) const {
+    TRACE_SCOPE("MatchService::overlap_matrix", "match");
+    MatchMatrix m;
+    if (!is_valid_course(course_code)) { err = "BAD_COURSE"; return m; }
+    auto course_id = store.courses.find(course_code);
+    if (!course_id) return m; // nobody has enrolled yet
+
+    m.student_ids = store.students_in(*course_id);
+    std::sort(m.student_ids.begin(), m.student_ids.end());
+    m.student_ids.erase(std::unique(m.student_ids.begin(), m.student_ids.end()), m.student_ids.end());
+    const std::size_t n = m.student_ids.size();
+    m.hours.assign(n * n, 0);
+
+    std::vector<PackedWeek> packed;
+    packed.reserve(n);
+    for (int id : m.student_ids) packed.push_back(pack_week(store.availability_mask(id)));
+
+    // Block b owns rows [lo, hi) and fills cell (i, j) and its mirror (j, i) for j >= i,
+    // so every cell is written by exactly one task.
+    auto fill_rows = [&](std::size_t lo, std::size_t hi) {
+        for (std::size_t i = lo; i < hi; ++i) {
+            const PackedWeek& row = packed[i];
+            for (std::size_t j = i; j < n; ++j) {
+                auto h = static_cast<std::uint16_t>(shared_hours(row, packed[j]));
+                m.hours[i * n + j] = h;
+                m.hours[j * n + i] = h;
+            }
+        }
+    };
+    ThreadPool& pool = ThreadPool::shared();
+    std::vector<std::future<void>> blocks;
+    for (std::size_t lo = 0; lo < n; lo += kMatrixRowBlock) {
+        blocks.push_back(pool.submit([&, lo]{
+            TRACE_SCOPE("matrix rows", "match");
+            fill_rows(lo, std::min(n, lo + kMatrixRowBlock));
+        }));
+    }
+    for (auto& b : blocks) b.get();
+    return m;
+}
+
+std::optional<std::filesystem::path> MatchService::export_path(std::string_view name, std::string& err) const {
+    namespace fs = std::filesystem;
+    fs::path rel{std::string(name)};
+    bool bad = rel.empty() || rel.has_root_path() || !rel.has_filename();
+    for (const auto& part : rel) bad = bad || part == ".." || part == ".";
+    if (bad) { err = "BAD_PATH"; return std::nullopt; }
+    // Resolve symlinks before creating anything, so a link inside exports/ cannot lead
+    // the write (or the directories for it) somewhere else.
+    const fs::path dir = store.dataDir / "exports";
+    const fs::path path = dir / rel;
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    fs::path root = fs::weakly_canonical(dir, ec);
+    fs::path inside = ec ? fs::path() : fs::weakly_canonical(path, ec).lexically_relative(root);
+    if (ec || inside.empty() || *inside.begin() == ".." || store.owns_file(path)) { err = "BAD_PATH"; return std::nullopt; }
+    fs::create_directories(path.parent_path(), ec);
+    return path;
+}
+
+// Binary matrix layout (host byte order): magic "SBMATRIX" | u32 n | i32 student_ids[n] | u16 hours[n*n].
+bool MatchService::write_matrix(const MatchMatrix& m, const std::filesystem::path& path, bool binary) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    const std::size_t n = m.size();
+    if (binary) {
+        auto n32 = static_cast<std::uint32_t>(n);
+        out.write("SBMATRIX", 8);
+        out.write(reinterpret_cast<const char*>(&n32), sizeof(n32));
+        out.write(reinterpret_cast<const char*>(m.student_ids.data()), static_cast<std::streamsize>(n * sizeof(int)));
+        out.write(reinterpret_cast<const char*>(m.hours.data()), static_cast<std::streamsize>(m.hours.size() * sizeof(std::uint16_t)));
+    } else {
+        std::string line = "student_id";
+        for (int id : m.student_ids) { line += ','; line += std::to_string(id); }
+        out << line << "\n";
+        for (std::size_t i = 0; i < n; ++i) {
+            line = std::to_string(m.student_ids[i]);
+            for (std::size_t j = 0; j < n; ++j) { line += ','; line += std::to_string(m.at(i, j)); }
+            out << line << "\n";
+        }
+    }
+    out.flush();
+    return static_cast<bool>(out);
+}
@@ -1,61 +1,76 @@
-
 #include "services_profile.h"
 #include "validation.h"
 #include <iostream>
 #include <functional>
 
-std::optional<int> ProfileService::create_profile(const std::string& name, const std::string& email, const std::optional<std::string>& passcode) {
-    if (!is_valid_email(email)) {
-        std::cerr << "[ERROR] BAD_EMAIL: " << email << "\n";
-        return std::nullopt;
-    }
-    if (store.studentsByEmail.count(email)) {
-        std::cerr << "[ERROR] DUP_EMAIL: " << email << "\n";
+std::optional<int> ProfileService::create_profile(std::string_view name, std::string_view email, std::optional<std::string_view> passcode) {
+    std::string err;
+    auto id = create_profile(name, email, passcode, err);
+    if (!id) {
+        std::cerr << "[ERROR] " << err << ": " << email << "\n";
         return std::nullopt;
     }
+    std::cout << "Profile created: id=" << *id << "\n";
+    return id;
+}
+
+bool ProfileService::edit_profile_name(int student_id, std::string_view new_name) {
+    std::string err;
+    if (edit_profile_name(student_id, new_name, err)) return true;
+    std::cerr << "[ERROR] " << err << "\n";
+    return false;
+}
+
+bool ProfileService::edit_profile_email(int student_id, std::string_view new_email) {
+    std::string err;
+    if (edit_profile_email(student_id, new_email, err)) return true;
+    std::cerr << "[ERROR] " << err << "\n";
+    return false;
+}
+
+std::optional<int> ProfileService::create_profile(std::string_view name, std::string_view email,
+                                                  std::optional<std::string_view> passcode, std::string& err) {
+    if (!is_valid_email(email)) { err = "BAD_EMAIL"; return std::nullopt; }
+    if (store.student_by_email(email)) { err = "DUP_EMAIL"; return std::nullopt; }
+    Storage::Transaction txn(store);
     Student s;
     s.id = store.nextStudentId++;
     s.name = name;
     s.email = email;
     if (passcode && !passcode->empty()) {
-        std::hash<std::string> hasher;
+        std::hash<std::string_view> hasher; // same value as std::hash<std::string>
         s.pass_hash = hasher(*passcode);
     }
+    store.undo_student(s.id);
     store.students[s.id] = s;
     store.studentsByEmail[s.email] = s.id;
-    store.save_students();
-    std::cout << "Profile created: id=" << s.id << "\n";
+    store.journal_student(s);
+    if (!txn.commit()) { err = "IO_WRITE"; return std::nullopt; }
     return s.id;
 }
 
-bool ProfileService::edit_profile_name(int student_id, const std::string& new_name) {
+bool ProfileService::edit_profile_name(int student_id, std::string_view new_name, std::string& err) {
     auto it = store.students.find(student_id);
-    if (it == store.students.end()) {
-        std::cerr << "[ERROR] NO_STUDENT\n";
-        return false;
-    }
+    if (it == store.students.end()) { err = "NO_STUDENT"; return false; }
+    Storage::Transaction txn(store);
+    store.undo_student(student_id);
     it->second.name = new_name;
-    store.save_students();
+    store.journal_student(it->second);
+    if (!txn.commit()) { err = "IO_WRITE"; return false; }
     return true;
 }
 
-bool ProfileService::edit_profile_email(int student_id, const std::string& new_email) {
-    if (!is_valid_email(new_email)) {
-        std::cerr << "[ERROR] BAD_EMAIL\n";
-        return false;
-    }
-    if (store.studentsByEmail.count(new_email)) {
-        std::cerr << "[ERROR] DUP_EMAIL\n";
-        return false;
-    }
+bool ProfileService::edit_profile_email(int student_id, std::string_view new_email, std::string& err) {
+    if (!is_valid_email(new_email)) { err = "BAD_EMAIL"; return false; }
+    if (store.student_by_email(new_email)) { err = "DUP_EMAIL"; return false; }
     auto it = store.students.find(student_id);
-    if (it == store.students.end()) {
-        std::cerr << "[ERROR] NO_STUDENT\n";
-        return false;
-    }
+    if (it == store.students.end()) { err = "NO_STUDENT"; return false; }
+    Storage::Transaction txn(store);
+    store.undo_student(student_id);
     store.studentsByEmail.erase(it->second.email);
     it->second.email = new_email;
-    store.studentsByEmail[new_email] = student_id;
-    store.save_students();
+    store.studentsByEmail[it->second.email] = student_id;
+    store.journal_student(it->second);
+    if (!txn.commit()) { err = "IO_WRITE"; return false; }
     return true;
 }
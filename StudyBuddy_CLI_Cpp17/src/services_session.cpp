@@ -1,28 +1,55 @@
 
 #include "services_session.h"
 #include "validation.h"
+#include "trace.h"
 #include <algorithm>
 #include <iostream>
 
 bool SessionService::has_conflict(int student_id, int day, int start) const {
-    for (const auto& kv : store.sessions) {
-        const Session& s = kv.second;
-        if (s.status != SessionStatus::CONFIRMED) continue;
-        if (s.day == day && s.start == start) {
-            if (s.organizer_id == student_id) return true;
-            for (const auto& p : store.participants) {
-                if (p.session_id == s.id && p.student_id == student_id && p.confirmed) return true;
-            }
+    if (!is_valid_day(day) || start < 0 || start >= kHoursPerDay) return false;
+    return store.busy_mask(student_id).test(week_bit(day, start));
+}
+
+std::vector<CommonSlot> SessionService::find_common_slots(int requester_id, std::string_view course_code,
+                                                          IdSpan with, std::string& err) const {
+    TRACE_SCOPE("SessionService::find_common_slots", "session");
+    std::vector<CommonSlot> out;
+    if (!is_valid_course(course_code)) { err = "BAD_COURSE"; return out; }
+    auto course_id = store.courses.find(course_code);
+    if (!course_id || !courseSvc.enrolled(requester_id, *course_id)) { err = "NOT_ENROLLED"; return out; }
+
+    WeekMask free = store.availability_mask(requester_id) & ~store.busy_mask(requester_id);
+    for (int uid : with) {
+        if (uid == requester_id) continue;
+        if (!store.students.count(uid)) { err = "INV_ID"; return out; }
+        if (!courseSvc.enrolled(uid, *course_id)) { err = "INV_NOT_ENROLLED"; return out; }
+        free &= store.availability_mask(uid) & ~store.busy_mask(uid);
+        if (free.none()) return out;
+    }
+
+    for (int d = 0; d < kDaysPerWeek; ++d) {
+        for (int h = 0; h < kHoursPerDay; ) {
+            if (!free.test(week_bit(d, h))) { ++h; continue; }
+            int end = h;
+            while (end < kHoursPerDay && free.test(week_bit(d, end))) ++end;
+            for (int k = h; k < end; ++k) out.push_back(CommonSlot{d, k, h, end});
+            h = end;
         }
     }
-    return false;
+    // Already in week order, so a stable sort on window length keeps it within ties.
+    std::stable_sort(out.begin(), out.end(), [](const CommonSlot& a, const CommonSlot& b){
+        return a.window_end - a.window_start > b.window_end - b.window_start;
+    });
+    return out;
 }
 
-bool SessionService::schedule_session(int organizer_id, const std::string& course_code, int day, int start,
-                          const std::vector<int>& invitees, std::string& err) {
+bool SessionService::schedule_session(int organizer_id, std::string_view course_code, int day, int start,
+                          IdSpan invitees, std::string& err) {
+    TRACE_SCOPE("SessionService::schedule_session", "session");
     if (!is_valid_course(course_code)) { err = "BAD_COURSE"; return false; }
     if (!is_valid_day(day) || !(0 <= start && start <= 23)) { err = "BAD_TIME"; return false; }
-    if (!courseSvc.enrolled(organizer_id, course_code)) { err = "NOT_ENROLLED_ORG"; return false; }
+    auto course_id = store.courses.find(course_code);
+    if (!course_id || !courseSvc.enrolled(organizer_id, *course_id)) { err = "NOT_ENROLLED_ORG"; return false; }
     if (!availSvc.within_availability(organizer_id, day, start, start+1)) { err = "OUTSIDE_AVAIL_ORG"; return false; }
     if (has_conflict(organizer_id, day, start)) { err = "ORG_CONFLICT"; return false; }
 
@@ -31,79 +58,143 @@ bool SessionService::schedule_session(int organizer_id, const std::string& cours
     for (int uid : invitees) {
         if (uid == organizer_id) continue;
         if (!store.students.count(uid)) { err = "INV_ID"; return false; }
-        if (!courseSvc.enrolled(uid, course_code)) { err = "INV_NOT_ENROLLED"; return false; }
+        if (!courseSvc.enrolled(uid, *course_id)) { err = "INV_NOT_ENROLLED"; return false; }
         if (seen.insert(uid).second) uniq.push_back(uid);
     }
     if (uniq.empty()) { err = "NO_INVITEES"; return false; }
 
+    Storage::Transaction txn(store);
+    propose(*course_id, day, start, organizer_id, uniq);
+    if (!txn.commit()) { err = "IO_WRITE"; return false; }
+    return true;
+}
+
+// Create and journal a PROPOSED session; invitees must be distinct and exclude the organizer.
+Session SessionService::propose(int course_id, int day, int start, int organizer_id, IdSpan invitees) {
     int sid = store.nextSessionId++;
     Session s;
-    s.id = sid; s.course_code = course_code; s.day = day; s.start = start; s.duration = 1;
+    s.id = sid; s.course_id = course_id; s.day = day; s.start = start; s.duration = 1;
     s.organizer_id = organizer_id; s.status = SessionStatus::PROPOSED;
+    store.undo_session(sid);
     store.sessions[sid] = s;
 
-    store.participants.push_back(SessionParticipant{sid, organizer_id, false});
-    for (int uid : uniq) store.participants.push_back(SessionParticipant{sid, uid, false});
+    store.upsert_participant(SessionParticipant{sid, organizer_id, false});
+    for (int uid : invitees) store.upsert_participant(SessionParticipant{sid, uid, false});
 
-    store.save_sessions();
-    store.save_participants();
-    return true;
+    store.journal_session(s);
+    store.journal_participant(SessionParticipant{sid, organizer_id, false});
+    for (int uid : invitees) store.journal_participant(SessionParticipant{sid, uid, false});
+    return s;
+}
+
+std::vector<Session> SessionService::auto_schedule(int requester_id, std::string_view course_code, int group_size, std::string& err) {
+    TRACE_SCOPE("SessionService::auto_schedule", "session");
+    std::vector<Session> out;
+    if (!is_valid_course(course_code)) { err = "BAD_COURSE"; return out; }
+    if (group_size < 2) { err = "BAD_SIZE"; return out; }
+    auto course_id = store.courses.find(course_code);
+    if (!course_id || !courseSvc.enrolled(requester_id, *course_id)) { err = "NOT_ENROLLED"; return out; }
+
+    std::vector<int> ids = store.students_in(*course_id);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    // Free hours per student, the students free in each hour (ascending id), and how
+    // many of those are still ungrouped.
+    std::vector<WeekMask> free(ids.size());
+    std::vector<std::vector<int>> byHour(kHoursPerWeek);
+    std::vector<int> count(kHoursPerWeek, 0);
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        free[i] = store.availability_mask(ids[i]) & ~store.busy_mask(ids[i]);
+        for (int h = 0; h < kHoursPerWeek; ++h) {
+            if (free[i].test(static_cast<std::size_t>(h))) { byHour[h].push_back(static_cast<int>(i)); ++count[h]; }
+        }
+    }
+    Storage::Transaction txn(store); // all proposals reach the journal in one write
+    std::vector<char> grouped(ids.size(), 0);
+    std::vector<std::size_t> cursor(kHoursPerWeek, 0); // byHour[h][0..cursor) are all grouped
+
+    while (true) {
+        int best = static_cast<int>(std::max_element(count.begin(), count.end()) - count.begin());
+        if (count[best] < 2) break; // nobody left to pair up
+        std::vector<int> members;
+        auto& candidates = byHour[best];
+        for (std::size_t& k = cursor[best]; k < candidates.size() && static_cast<int>(members.size()) < group_size; ++k) {
+            if (!grouped[candidates[k]]) members.push_back(candidates[k]);
+        }
+        for (int i : members) {
+            grouped[i] = 1;
+            for (int h = 0; h < kHoursPerWeek; ++h) if (free[i].test(static_cast<std::size_t>(h))) --count[h];
+        }
+        std::vector<int> invitees;
+        for (std::size_t m = 1; m < members.size(); ++m) invitees.push_back(ids[members[m]]);
+        out.push_back(propose(*course_id, best / kHoursPerDay, best % kHoursPerDay, ids[members[0]], invitees));
+    }
+    if (!txn.commit()) { err = "IO_WRITE"; out.clear(); }
+    return out;
 }
 
 bool SessionService::confirm_session(int actor_id, int session_id, std::string& err) {
+    TRACE_SCOPE("SessionService::confirm_session", "session");
     auto it = store.sessions.find(session_id);
     if (it == store.sessions.end()) { err = "NO_SESSION"; return false; }
     Session& s = it->second;
     if (s.status == SessionStatus::CANCELLED) { err = "CANCELLED"; return false; }
     // Find participant
-    bool found = false;
-    for (auto& p : store.participants) {
-        if (p.session_id == session_id && p.student_id == actor_id) {
-            found = true;
-            if (has_conflict(actor_id, s.day, s.start)) { err = "TIME_CONFLICT"; return false; }
-            if (!availSvc.within_availability(actor_id, s.day, s.start, s.start+1)) { err = "OUTSIDE_AVAIL"; return false; }
-            p.confirmed = true;
-            break;
-        }
-    }
-    if (!found) { err = "NOT_PARTICIPANT"; return false; }
+    auto& participants = store.participantsBySession[session_id];
+    auto me = std::find_if(participants.begin(), participants.end(),
+                           [&](const SessionParticipant& p){ return p.student_id == actor_id; });
+    if (me == participants.end()) { err = "NOT_PARTICIPANT"; return false; }
+    if (has_conflict(actor_id, s.day, s.start)) { err = "TIME_CONFLICT"; return false; }
+    if (!availSvc.within_availability(actor_id, s.day, s.start, s.start+1)) { err = "OUTSIDE_AVAIL"; return false; }
+
+    // The participant row and the status change are journaled together.
+    Storage::Transaction txn(store);
+    store.undo_session(session_id);
+    me->confirmed = true;
+    store.journal_participant(*me);
     // Check if all confirmed
     bool allConfirmed = true;
-    for (const auto& p : store.participants) {
-        if (p.session_id == session_id && !p.confirmed) { allConfirmed = false; break; }
+    for (const auto& p : participants) {
+        if (!p.confirmed) { allConfirmed = false; break; }
     }
     if (allConfirmed) {
         s.status = SessionStatus::CONFIRMED;
-        store.save_sessions();
+        store.mark_busy(s);
+        store.journal_session(s);
     }
-    store.save_participants();
+    if (!txn.commit()) { err = "IO_WRITE"; return false; }
     return true;
 }
 
-bool SessionService::cancel_session(int actor_id, int session_id, const std::string& reason, std::string& err) {
+bool SessionService::cancel_session(int actor_id, int session_id, std::string_view reason, std::string& err) {
+    TRACE_SCOPE("SessionService::cancel_session", "session");
     auto it = store.sessions.find(session_id);
     if (it == store.sessions.end()) { err = "NO_SESSION"; return false; }
     Session& s = it->second;
     bool isParticipant = false;
     if (s.organizer_id == actor_id) isParticipant = true;
-    for (const auto& p : store.participants) if (p.session_id == session_id && p.student_id == actor_id) { isParticipant = true; break; }
+    for (const auto& p : store.participants_of(session_id)) if (p.student_id == actor_id) { isParticipant = true; break; }
     if (!isParticipant) { err = "NOT_PARTICIPANT"; return false; }
+    Storage::Transaction txn(store);
+    store.undo_session(session_id);
+    bool wasConfirmed = s.status == SessionStatus::CONFIRMED;
     s.status = SessionStatus::CANCELLED;
-    s.cancel_reason = reason;
-    store.save_sessions();
+    s.cancel_reason = std::string(reason);
+    if (wasConfirmed) {
+        store.recompute_busy(s.organizer_id);
+        for (const auto& p : store.participants_of(session_id)) store.recompute_busy(p.student_id);
+    }
+    store.journal_session(s);
+    if (!txn.commit()) { err = "IO_WRITE"; return false; }
     return true;
 }
 
 std::vector<Session> SessionService::list_sessions_for(int student_id) const {
     std::vector<Session> out;
-    for (const auto& kv : store.sessions) {
-        const Session& s = kv.second;
-        if (s.organizer_id == student_id) out.push_back(s);
-        else {
-            for (const auto& p : store.participants) {
-                if (p.session_id == s.id && p.student_id == student_id) { out.push_back(s); break; }
-            }
-        }
+    for (int sid : store.sessions_of(student_id)) {
+        auto it = store.sessions.find(sid);
+        if (it != store.sessions.end()) out.push_back(it->second);
     }
     std::sort(out.begin(), out.end(), [](const Session& a, const Session& b){
         if (a.status != b.status) return static_cast<int>(a.status) < static_cast<int>(b.status);
@@ -122,11 +213,11 @@ std::vector<Session> SessionService::list_sessions_by_status_for(int student_id,
 
 std::vector<Session> SessionService::list_pending_invitations_for(int student_id) const {
     std::vector<Session> out;
-    for (const auto& p : store.participants) {
-        if (p.student_id == student_id && !p.confirmed) {
-            auto it = store.sessions.find(p.session_id);
-            if (it != store.sessions.end() && it->second.status == SessionStatus::PROPOSED)
-                out.push_back(it->second);
+    for (int sid : store.sessions_of(student_id)) {
+        auto it = store.sessions.find(sid);
+        if (it == store.sessions.end() || it->second.status != SessionStatus::PROPOSED) continue;
+        for (const auto& p : store.participants_of(sid)) {
+            if (p.student_id == student_id && !p.confirmed) { out.push_back(it->second); break; }
         }
     }
     std::sort(out.begin(), out.end(), [](const Session& a, const Session& b){
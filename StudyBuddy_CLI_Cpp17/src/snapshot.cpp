@@ -0,0 +1,336 @@
+#include "storage.h"
+#include "metrics.h"
+#include "trace.h"
+#include "file_io.h"
+#include "validation.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <type_traits>
+
+// snapshot.bin layout (host byte order; the header records it so a foreign file is rejected):
+//
+//   header   magic "SBSNAP\0\0" | u32 version | u32 byte-order mark | u64 payload size | u64 FNV-1a of payload
+//   payload  i32 nextStudentId, i32 nextSessionId
+//            string table: column<u32> end offsets, column<char> bytes
+//            courses:      column<u32> code, indexed by course_id
+//            students:     column<i32> id, column<u32> name, column<u32> email, column<u8> has_hash, column<u64> hash
+//            enrollments:  column<i32> student_id, column<i32> course_id
+//            availability: column<i32> student_id, day, start, end
+//            sessions:     column<i32> id, column<i32> course_id, column<i32> day, start, duration, organizer_id,
+//                          column<u8> status, column<u32> cancel_reason (kNoString if unset)
+//            participants: column<i32> session_id, student_id, column<u8> confirmed
+//
+// A column is a u64 element count followed by the raw elements, padded to 8 bytes,
+// so loading a column is a bounds check and one memcpy. Strings are indexes into
+// the deduplicated string table.
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'B', 'S', 'N', 'A', 'P', 0, 0};
+constexpr std::uint32_t kVersion = 2;
+constexpr std::uint32_t kByteOrderMark = 0x01020304;
+constexpr std::uint32_t kNoString = 0xFFFFFFFFu;
+constexpr std::size_t kHeaderSize = 8 + 4 + 4 + 8 + 8;
+
+std::uint64_t fnv1a(std::string_view bytes) {
+    std::uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : bytes) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+class SnapshotWriter {
+public:
+    template <typename T>
+    void put(T v) {
+        static_assert(std::is_trivially_copyable<T>::value, "fixed-width values only");
+        buf.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    template <typename T>
+    void column(const std::vector<T>& v) {
+        put<std::uint64_t>(v.size());
+        if (!v.empty()) buf.append(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+        buf.append((8 - buf.size() % 8) % 8, '\0');
+    }
+
+    // Index of `s` in the string table, adding it on first use.
+    std::uint32_t intern(const std::string& s) {
+        auto it = ids.find(s);
+        if (it != ids.end()) return it->second;
+        std::uint32_t id = static_cast<std::uint32_t>(ends.size());
+        bytes.insert(bytes.end(), s.begin(), s.end());
+        ends.push_back(static_cast<std::uint32_t>(bytes.size()));
+        ids.emplace(s, id);
+        return id;
+    }
+
+    std::vector<std::uint32_t> ends;
+    std::vector<char> bytes;
+    std::string buf;
+
+private:
+    std::unordered_map<std::string, std::uint32_t> ids;
+};
+
+class SnapshotReader {
+public:
+    explicit SnapshotReader(std::string_view payload): data(payload) {}
+
+    template <typename T>
+    bool get(T& v) {
+        if (data.size() - pos < sizeof(T)) return false;
+        std::memcpy(&v, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool column(std::vector<T>& v, std::size_t expected = SIZE_MAX) {
+        std::uint64_t n;
+        if (!get(n)) return false;
+        if (expected != SIZE_MAX && n != expected) return false;
+        if (n > (data.size() - pos) / sizeof(T)) return false;
+        v.resize(static_cast<std::size_t>(n));
+        if (n) std::memcpy(v.data(), data.data() + pos, static_cast<std::size_t>(n) * sizeof(T));
+        pos += static_cast<std::size_t>(n) * sizeof(T);
+        std::size_t pad = (8 - pos % 8) % 8;
+        if (data.size() - pos < pad) return false;
+        pos += pad;
+        return true;
+    }
+
+    bool at_end() const { return pos == data.size(); }
+
+private:
+    std::string_view data;
+    std::size_t pos{0};
+};
+
+} // namespace
+
+bool Storage::write_snapshot(const std::filesystem::path& path) {
+    TRACE_SCOPE("Storage::write_snapshot", "storage");
+    ScopedTimer timer(save_histogram());
+    SnapshotWriter w;
+    w.put<std::int32_t>(nextStudentId);
+    w.put<std::int32_t>(nextSessionId);
+
+    // Build every column first so the string table is complete before it is written.
+    std::vector<std::uint32_t> courseCode;
+    courseCode.reserve(courses.size());
+    for (std::size_t id = 0; id < courses.size(); ++id) courseCode.push_back(w.intern(courses.code(static_cast<int>(id))));
+    std::vector<std::int32_t> stuId;
+    std::vector<std::uint32_t> stuName, stuEmail;
+    std::vector<std::uint8_t> stuHasHash;
+    std::vector<std::uint64_t> stuHash;
+    for (const auto& kv : students) {
+        const Student& s = kv.second;
+        stuId.push_back(s.id);
+        stuName.push_back(w.intern(s.name));
+        stuEmail.push_back(w.intern(s.email));
+        stuHasHash.push_back(s.pass_hash ? 1 : 0);
+        stuHash.push_back(s.pass_hash ? static_cast<std::uint64_t>(*s.pass_hash) : 0);
+    }
+    std::vector<std::int32_t> enrStudent, enrCourse;
+    for (const auto& kv : enrollmentsByStudent) {
+        for (const auto& e : kv.second) {
+            enrStudent.push_back(e.student_id);
+            enrCourse.push_back(e.course_id);
+        }
+    }
+    std::vector<std::int32_t> avStudent, avDay, avStart, avEnd;
+    for (const auto& kv : availabilityByStudent) {
+        for (const auto& a : kv.second) {
+            avStudent.push_back(a.student_id);
+            avDay.push_back(a.day);
+            avStart.push_back(a.start);
+            avEnd.push_back(a.end);
+        }
+    }
+    std::vector<std::int32_t> sesId, sesCourse, sesDay, sesStart, sesDuration, sesOrganizer;
+    std::vector<std::uint32_t> sesReason;
+    std::vector<std::uint8_t> sesStatus;
+    for (const auto& kv : sessions) {
+        const Session& s = kv.second;
+        sesId.push_back(s.id);
+        sesCourse.push_back(s.course_id);
+        sesDay.push_back(s.day);
+        sesStart.push_back(s.start);
+        sesDuration.push_back(s.duration);
+        sesOrganizer.push_back(s.organizer_id);
+        sesStatus.push_back(static_cast<std::uint8_t>(s.status));
+        sesReason.push_back(s.cancel_reason ? w.intern(*s.cancel_reason) : kNoString);
+    }
+    std::vector<std::int32_t> parSession, parStudent;
+    std::vector<std::uint8_t> parConfirmed;
+    for (const auto& kv : participantsBySession) {
+        for (const auto& p : kv.second) {
+            parSession.push_back(p.session_id);
+            parStudent.push_back(p.student_id);
+            parConfirmed.push_back(p.confirmed ? 1 : 0);
+        }
+    }
+
+    w.column(w.ends); w.column(w.bytes);
+    w.column(courseCode);
+    w.column(stuId); w.column(stuName); w.column(stuEmail); w.column(stuHasHash); w.column(stuHash);
+    w.column(enrStudent); w.column(enrCourse);
+    w.column(avStudent); w.column(avDay); w.column(avStart); w.column(avEnd);
+    w.column(sesId); w.column(sesCourse); w.column(sesDay); w.column(sesStart); w.column(sesDuration);
+    w.column(sesOrganizer); w.column(sesStatus); w.column(sesReason);
+    w.column(parSession); w.column(parStudent); w.column(parConfirmed);
+
+    std::string out;
+    out.reserve(kHeaderSize + w.buf.size());
+    out.append(kMagic, sizeof(kMagic));
+    auto put_raw = [&](auto v){ out.append(reinterpret_cast<const char*>(&v), sizeof(v)); };
+    put_raw(kVersion);
+    put_raw(kByteOrderMark);
+    put_raw(static_cast<std::uint64_t>(w.buf.size()));
+    put_raw(fnv1a(w.buf));
+    out += w.buf;
+    return atomic_write(path, out);
+}
+
+bool Storage::read_snapshot(const std::filesystem::path& path) {
+    TRACE_SCOPE("Storage::read_snapshot", "storage");
+    MappedFile file(path);
+    std::string_view all = file.view();
+    auto fail = [&](const char* why){
+        std::cerr << "Warning: ignoring snapshot " << path << ": " << why << "\n";
+        return false;
+    };
+    if (all.size() < kHeaderSize || std::memcmp(all.data(), kMagic, sizeof(kMagic)) != 0) return fail("not a snapshot");
+    std::uint32_t version, bom;
+    std::uint64_t size, sum;
+    std::memcpy(&version, all.data() + 8, 4);
+    std::memcpy(&bom, all.data() + 12, 4);
+    std::memcpy(&size, all.data() + 16, 8);
+    std::memcpy(&sum, all.data() + 24, 8);
+    if (version != kVersion) return fail("unsupported version");
+    if (bom != kByteOrderMark) return fail("written on a machine with a different byte order");
+    std::string_view payload = all.substr(kHeaderSize);
+    if (payload.size() != size) return fail("truncated");
+    if (fnv1a(payload) != sum) return fail("checksum mismatch");
+
+    SnapshotReader r(payload);
+    std::int32_t nextStu, nextSes;
+    std::vector<std::uint32_t> ends;
+    std::vector<char> bytes;
+    if (!r.get(nextStu) || !r.get(nextSes) || !r.column(ends) || !r.column(bytes)) return fail("corrupt header");
+    std::vector<std::string> strings;
+    strings.reserve(ends.size());
+    std::uint32_t begin = 0;
+    for (std::uint32_t end : ends) {
+        if (end < begin || end > bytes.size()) return fail("corrupt string table");
+        strings.emplace_back(bytes.data() + begin, end - begin);
+        begin = end;
+    }
+    auto str = [&](std::uint32_t id, std::string& out){
+        if (id >= strings.size()) return false;
+        out = strings[id];
+        return true;
+    };
+
+    // Course ids are positions in this column; re-interning in order reproduces them.
+    std::vector<std::uint32_t> courseCode;
+    if (!r.column(courseCode)) return fail("corrupt courses");
+    CourseDictionary newCourses;
+    for (std::size_t id = 0; id < courseCode.size(); ++id) {
+        std::string code;
+        if (!str(courseCode[id], code) || newCourses.intern(code) != static_cast<int>(id)) return fail("corrupt courses");
+    }
+    auto course_ok = [&](std::int32_t id){ return id >= 0 && static_cast<std::size_t>(id) < newCourses.size(); };
+
+    std::vector<std::int32_t> stuId;
+    std::vector<std::uint32_t> stuName, stuEmail;
+    std::vector<std::uint8_t> stuHasHash;
+    std::vector<std::uint64_t> stuHash;
+    if (!r.column(stuId)) return fail("corrupt students");
+    std::size_t n = stuId.size();
+    if (!r.column(stuName, n) || !r.column(stuEmail, n) || !r.column(stuHasHash, n) || !r.column(stuHash, n)) return fail("corrupt students");
+
+    std::vector<std::int32_t> enrStudent, enrCourse;
+    if (!r.column(enrStudent) || !r.column(enrCourse, enrStudent.size())) return fail("corrupt enrollments");
+
+    std::vector<std::int32_t> avStudent, avDay, avStart, avEnd;
+    if (!r.column(avStudent)) return fail("corrupt availability");
+    n = avStudent.size();
+    if (!r.column(avDay, n) || !r.column(avStart, n) || !r.column(avEnd, n)) return fail("corrupt availability");
+
+    std::vector<std::int32_t> sesId, sesCourse, sesDay, sesStart, sesDuration, sesOrganizer;
+    std::vector<std::uint32_t> sesReason;
+    std::vector<std::uint8_t> sesStatus;
+    if (!r.column(sesId)) return fail("corrupt sessions");
+    n = sesId.size();
+    if (!r.column(sesCourse, n) || !r.column(sesDay, n) || !r.column(sesStart, n) || !r.column(sesDuration, n)
+        || !r.column(sesOrganizer, n) || !r.column(sesStatus, n) || !r.column(sesReason, n)) return fail("corrupt sessions");
+
+    std::vector<std::int32_t> parSession, parStudent;
+    std::vector<std::uint8_t> parConfirmed;
+    if (!r.column(parSession)) return fail("corrupt participants");
+    n = parSession.size();
+    if (!r.column(parStudent, n) || !r.column(parConfirmed, n) || !r.at_end()) return fail("corrupt participants");
+
+    // Decode into fresh tables so a bad reference leaves the current state untouched.
+    decltype(students) newStudents;
+    newStudents.reserve(stuId.size());
+    for (std::size_t i = 0; i < stuId.size(); ++i) {
+        Student s;
+        s.id = stuId[i];
+        if (!str(stuName[i], s.name) || !str(stuEmail[i], s.email)) return fail("corrupt students");
+        if (stuHasHash[i]) s.pass_hash = static_cast<std::size_t>(stuHash[i]);
+        newStudents[s.id] = std::move(s);
+    }
+    decltype(enrollmentsByStudent) newEnrollments;
+    for (std::size_t i = 0; i < enrStudent.size(); ++i) {
+        if (!course_ok(enrCourse[i])) return fail("corrupt enrollments");
+        newEnrollments[enrStudent[i]].push_back(Enrollment{enrStudent[i], enrCourse[i]});
+    }
+    decltype(availabilityByStudent) newAvailability;
+    for (std::size_t i = 0; i < avStudent.size(); ++i) {
+        if (!is_valid_day(avDay[i]) || !is_valid_hour(avStart[i]) || !is_valid_hour(avEnd[i])) return fail("corrupt availability");
+        newAvailability[avStudent[i]].push_back(Availability{avStudent[i], avDay[i], avStart[i], avEnd[i]});
+    }
+    decltype(sessions) newSessions;
+    newSessions.reserve(sesId.size());
+    for (std::size_t i = 0; i < sesId.size(); ++i) {
+        Session s;
+        s.id = sesId[i];
+        if (!course_ok(sesCourse[i]) || sesStatus[i] > static_cast<std::uint8_t>(SessionStatus::CANCELLED)
+            || !is_valid_day(sesDay[i]) || sesStart[i] < 0 || sesStart[i] >= kHoursPerDay) return fail("corrupt sessions");
+        s.course_id = sesCourse[i];
+        s.day = sesDay[i]; s.start = sesStart[i]; s.duration = sesDuration[i]; s.organizer_id = sesOrganizer[i];
+        s.status = static_cast<SessionStatus>(sesStatus[i]);
+        if (sesReason[i] != kNoString) {
+            std::string reason;
+            if (!str(sesReason[i], reason)) return fail("corrupt sessions");
+            s.cancel_reason = std::move(reason);
+        }
+        newSessions[s.id] = std::move(s);
+    }
+    decltype(participantsBySession) newParticipants;
+    for (std::size_t i = 0; i < parSession.size(); ++i) {
+        newParticipants[parSession[i]].push_back(SessionParticipant{parSession[i], parStudent[i], parConfirmed[i] != 0});
+    }
+
+    courses = std::move(newCourses);
+    students.swap(newStudents);
+    enrollmentsByStudent.swap(newEnrollments);
+    availabilityByStudent.swap(newAvailability);
+    sessions.swap(newSessions);
+    participantsBySession.swap(newParticipants);
+    nextStudentId = nextStu;
+    nextSessionId = nextSes;
+    return true;
+}
+
+bool Storage::import_snapshot(const std::filesystem::path& path) {
+    if (!read_snapshot(path)) return false;
+    recompute_indices();
+    set_next_ids();
+    dirtyTables = kAllTables; // every CSV now differs from memory
+    return true;
+}
@@ -1,23 +1,256 @@
 
 #include "storage.h"
 #include "csv.h"
+#include "file_io.h"
+#include "metrics.h"
+#include "trace.h"
+#include "thread_pool.h"
+#include "validation.h"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
 using std::string;
 namespace fs = std::filesystem;
 
-Storage::Storage(const std::string& data_dir) {
+// Row codecs shared by the CSV loader and journal replay. `o` is the index of the
+// first table column, so journal records can carry a leading tag field. The
+// *_from_fields decoders return false on a non-numeric id/day/hour column, or a
+// day or hour outside the week.
+using Fields = std::vector<std::string_view>;
+
+static const char* status_to_string(SessionStatus st) {
+    return (st == SessionStatus::PROPOSED) ? "PROPOSED"
+         : (st == SessionStatus::CONFIRMED) ? "CONFIRMED" : "CANCELLED";
+}
+
+static bool student_from_fields(const Fields& fields, Student& s, size_t o = 0) {
+    if (!csv::parse_int(fields[o], s.id)) return false;
+    s.name.assign(fields[o + 1]);
+    s.email.assign(fields[o + 2]);
+    s.pass_hash.reset();
+    if (fields.size() >= o + 4 && !fields[o + 3].empty()) {
+        std::size_t h;
+        if (!csv::parse_size(fields[o + 3], h)) return false;
+        s.pass_hash = h;
+    }
+    return true;
+}
+
+static std::vector<std::string> student_to_fields(const Student& s) {
+    std::string hashStr = s.pass_hash ? std::to_string(*s.pass_hash) : "";
+    return {std::to_string(s.id), s.name, s.email, hashStr};
+}
+
+// Enrollments and sessions name their course by code on disk. Decoders keep the code
+// next to the row, and it is interned into Storage::courses when the row is merged.
+struct EnrollmentRow {
+    int student_id{};
+    std::string course_code;
+};
+
+struct SessionRow {
+    Session session;
+    std::string course_code;
+};
+
+static bool enrollment_from_fields(const Fields& fields, EnrollmentRow& e, size_t o = 0) {
+    if (!csv::parse_int(fields[o], e.student_id)) return false;
+    e.course_code.assign(fields[o + 1]);
+    return true;
+}
+
+static bool availability_from_fields(const Fields& fields, Availability& a, size_t o = 0) {
+    return csv::parse_int(fields[o], a.student_id) && csv::parse_int(fields[o + 1], a.day)
+        && csv::parse_int(fields[o + 2], a.start) && csv::parse_int(fields[o + 3], a.end)
+        && is_valid_day(a.day) && is_valid_hour(a.start) && is_valid_hour(a.end);
+}
+
+static std::vector<std::string> availability_to_fields(const Availability& a) {
+    return {std::to_string(a.student_id), std::to_string(a.day), std::to_string(a.start), std::to_string(a.end)};
+}
+
+static bool session_from_fields(const Fields& fields, SessionRow& row, size_t o = 0) {
+    Session& s = row.session;
+    if (!csv::parse_int(fields[o], s.id)) return false;
+    row.course_code.assign(fields[o + 1]);
+    if (!csv::parse_int(fields[o + 2], s.day) || !csv::parse_int(fields[o + 3], s.start)
+        || !csv::parse_int(fields[o + 4], s.duration) || !csv::parse_int(fields[o + 5], s.organizer_id)) return false;
+    if (!is_valid_day(s.day) || s.start < 0 || s.start >= kHoursPerDay) return false;
+    std::string_view st = fields[o + 6];
+    if (st == "PROPOSED") s.status = SessionStatus::PROPOSED;
+    else if (st == "CONFIRMED") s.status = SessionStatus::CONFIRMED;
+    else s.status = SessionStatus::CANCELLED;
+    s.cancel_reason.reset();
+    if (fields.size() >= o + 8 && !fields[o + 7].empty()) s.cancel_reason = std::string(fields[o + 7]);
+    return true;
+}
+
+static std::vector<std::string> session_to_fields(const Session& s, const std::string& course_code) {
+    std::string cancelStr = s.cancel_reason ? *s.cancel_reason : "";
+    return {std::to_string(s.id), course_code, std::to_string(s.day), std::to_string(s.start),
+            std::to_string(s.duration), std::to_string(s.organizer_id), status_to_string(s.status), cancelStr};
+}
+
+static bool participant_from_fields(const Fields& fields, SessionParticipant& p, size_t o = 0) {
+    if (!csv::parse_int(fields[o], p.session_id) || !csv::parse_int(fields[o + 1], p.student_id)) return false;
+    p.confirmed = (fields[o + 2] == "true" || fields[o + 2] == "1");
+    return true;
+}
+
+// Feed every non-empty line of `path` to row(fields, line_number). The file is
+// mapped and scanned in place; the field and scratch buffers are reused across
+// lines, so a row costs no parser allocations.
+template <typename RowFn>
+static void scan_csv(const fs::path& path, const char* name, RowFn row) {
+    MappedFile file(path);
+    std::string_view buf = file.view();
+    Fields fields;
+    std::string scratch;
+    int ln=0;
+    size_t pos = 0;
+    while (pos < buf.size()) {
+        size_t nl = buf.find('\n', pos);
+        if (nl == std::string_view::npos) nl = buf.size();
+        std::string_view line = buf.substr(pos, nl - pos);
+        pos = nl + 1;
+        ++ln;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) continue;
+        if (!csv::parse_line(line, fields, scratch)) { std::cerr << "Warning: malformed line " << ln << " in " << name << "\n"; continue; }
+        row(fields, ln);
+    }
+}
+
+static std::vector<std::string> participant_to_fields(const SessionParticipant& p) {
+    return {std::to_string(p.session_id), std::to_string(p.student_id), p.confirmed ? "true" : "false"};
+}
+
+Storage::Storage(const std::string& data_dir, Durability mode) {
     dataDir = fs::path(data_dir);
     studentsFile = dataDir / "students.csv";
     enrollmentsFile = dataDir / "enrollments.csv";
     availabilityFile = dataDir / "availability.csv";
     sessionsFile = dataDir / "sessions.csv";
     participantsFile = dataDir / "session_participants.csv";
+    journalFile = dataDir / "journal.log";
+    snapshotFile = dataDir / "snapshot.bin";
     ensure_files();
+    persist = std::make_unique<PersistenceWorker>(journalFile, mode);
     load_all();
 }
 
+bool Storage::flush() {
+    return persist->drain();
+}
+
+bool Storage::owns_file(const fs::path& path) const {
+    std::error_code ec;
+    fs::path target = fs::weakly_canonical(path, ec);
+    if (ec) return true; // cannot resolve it, so do not let anyone write there
+    for (const auto& file : {studentsFile, enrollmentsFile, availabilityFile, sessionsFile, participantsFile, journalFile, snapshotFile}) {
+        fs::path tmp = file;
+        tmp += ".tmp";
+        for (const auto& own : {file, tmp}) {
+            fs::path resolved = fs::weakly_canonical(own, ec);
+            if (!ec && resolved == target) return true;
+        }
+    }
+    return false;
+}
+
+// Parallel table loading: one line-aligned slice of a table, parsed on a pool thread.
+// Warnings keep the slice-local line number until the slices are merged in order.
+template <typename Row>
+struct ParsedChunk {
+    std::vector<Row> rows;
+    std::vector<std::pair<int, const char*>> warnings; // (local line, "malformed line" etc.)
+    int lines{0};
+};
+
+static constexpr size_t kMinChunkBytes = 1 << 20;
+
+// Split `buf` into up to `parts` pieces, each ending just after a newline.
+static std::vector<std::string_view> split_lines(std::string_view buf, size_t parts) {
+    std::vector<std::string_view> out;
+    size_t begin = 0;
+    for (size_t i = 1; i < parts && begin < buf.size(); ++i) {
+        size_t cut = std::max(begin, buf.size() * i / parts);
+        size_t nl = buf.find('\n', cut);
+        if (nl == std::string_view::npos) break;
+        out.push_back(buf.substr(begin, nl + 1 - begin));
+        begin = nl + 1;
+    }
+    if (begin < buf.size()) out.push_back(buf.substr(begin));
+    return out;
+}
+
+// `decode(fields, row)` returns nullptr on success or the warning text for the line.
+template <typename Row, typename Decode>
+static ParsedChunk<Row> parse_chunk(std::string_view chunk, Decode decode) {
+    ParsedChunk<Row> out;
+    Fields fields;
+    std::string scratch;
+    Row row;
+    size_t pos = 0;
+    while (pos < chunk.size()) {
+        size_t nl = chunk.find('\n', pos);
+        if (nl == std::string_view::npos) nl = chunk.size();
+        std::string_view line = chunk.substr(pos, nl - pos);
+        pos = nl + 1;
+        int ln = ++out.lines;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty()) continue;
+        if (!csv::parse_line(line, fields, scratch)) { out.warnings.push_back({ln, "malformed line"}); continue; }
+        if (const char* warn = decode(fields, row)) { out.warnings.push_back({ln, warn}); continue; }
+        out.rows.push_back(std::move(row));
+    }
+    return out;
+}
+
+template <typename Row, typename Decode>
+static std::vector<std::future<ParsedChunk<Row>>> start_table(ThreadPool& pool, std::string_view buf, const char* span, Decode decode) {
+    size_t parts = std::min(std::max<size_t>(1, buf.size() / kMinChunkBytes), pool.size() * 2);
+    std::vector<std::future<ParsedChunk<Row>>> jobs;
+    for (std::string_view chunk : split_lines(buf, parts)) {
+        jobs.push_back(pool.submit([chunk, span, decode]{
+            TRACE_SCOPE(span, "storage");
+            return parse_chunk<Row>(chunk, decode);
+        }));
+    }
+    return jobs;
+}
+
+template <typename Row>
+static std::vector<ParsedChunk<Row>> finish_chunks(std::vector<std::future<ParsedChunk<Row>>>& jobs) {
+    std::vector<ParsedChunk<Row>> chunks;
+    chunks.reserve(jobs.size());
+    for (auto& j : jobs) chunks.push_back(j.get());
+    return chunks;
+}
+
+template <typename Row>
+static size_t total_rows(const std::vector<ParsedChunk<Row>>& chunks) {
+    size_t n = 0;
+    for (const auto& c : chunks) n += c.rows.size();
+    return n;
+}
+
+// Hand rows to `insert` in file order; returns the table's warnings, already formatted.
+template <typename Row, typename Insert>
+static std::string merge_chunks(std::vector<ParsedChunk<Row>>& chunks, const char* name, Insert insert) {
+    std::string warnings;
+    int base = 0;
+    for (auto& c : chunks) {
+        for (const auto& w : c.warnings) {
+            warnings += "Warning: " + std::string(w.second) + " " + std::to_string(base + w.first) + " in " + name + "\n";
+        }
+        for (auto& r : c.rows) insert(std::move(r));
+        base += c.lines;
+    }
+    return warnings;
+}
+
 void Storage::ensure_files() {
     try {
         fs::create_directories(dataDir);
@@ -31,215 +264,625 @@ void Storage::ensure_files() {
         ensure(availabilityFile);
         ensure(sessionsFile);
         ensure(participantsFile);
+        ensure(journalFile);
     } catch (const std::exception& e) {
         std::cerr << "[ERROR] Failed to ensure data directory/files: " << e.what() << "\n";
     }
 }
 
-void Storage::atomic_write(const fs::path& path, const std::vector<std::string>& lines) {
-    fs::path tmp = path; tmp += ".tmp";
-    std::ofstream ofs(tmp, std::ios::binary);
-    if (!ofs) { std::cerr << "[ERROR] IO_WRITE: cannot open temp for " << path << "\n"; return; }
+LatencyHistogram& Storage::save_histogram() {
+    static LatencyHistogram& h = Metrics::global().histogram("storage.save");
+    return h;
+}
+
+bool Storage::atomic_write(const fs::path& path, const std::vector<std::string>& lines) {
+    std::size_t total = lines.size();
+    for (const auto& l : lines) total += l.size();
+    std::string bytes;
+    bytes.reserve(total); // the whole table is handed to replace_file as one buffer
     for (size_t i = 0; i < lines.size(); ++i) {
-        ofs << lines[i];
-        if (i + 1 < lines.size()) ofs << "\n";
-    }
-    ofs.flush();
-    ofs.close();
-    std::error_code ec;
-    fs::rename(tmp, path, ec);
-    if (ec) {
-        // try replace
-        fs::remove(path, ec);
-        fs::rename(tmp, path, ec);
-        if (ec) std::cerr << "[ERROR] IO_RENAME: " << ec.message() << "\n";
+        bytes += lines[i];
+        if (i + 1 < lines.size()) bytes += "\n";
     }
+    return atomic_write(path, bytes);
+}
+
+bool Storage::atomic_write(const fs::path& path, const std::string& bytes) {
+    TRACE_SCOPE("Storage::atomic_write", "storage");
+    persist->replace(path, bytes);
+    return persist->mode() != Durability::Fsync || persist->drain();
 }
 
 void Storage::load_all() {
+    TRACE_SCOPE("Storage::load_all", "storage");
+    persist->drain(); // read back what was queued, not what happened to reach disk
     students.clear(); studentsByEmail.clear();
-    enrollments.clear(); enrollmentsByCourse.clear();
-    availability.clear();
-    sessions.clear(); participants.clear();
+    courses.clear();
+    enrollmentsByStudent.clear(); enrollmentsByCourse.clear();
+    availabilityByStudent.clear(); availabilityMasks.clear();
+    sessions.clear(); participantsBySession.clear(); sessionsByStudent.clear();
+    nextStudentId = 1; nextSessionId = 1;
 
-    // students.csv: id,name,email,pass_hash?
+    static LatencyHistogram& parseHist = Metrics::global().histogram("storage.parse");
+    static LatencyHistogram& indexHist = Metrics::global().histogram("storage.index");
     {
-        std::ifstream ifs(studentsFile);
-        std::string line; int ln=0;
-        while (std::getline(ifs, line)) {
-            ++ln;
-            if (line.empty()) continue;
-            auto fields = csv::parse_line(line);
-            if (fields.empty()) { std::cerr << "Warning: malformed line " << ln << " in students.csv\n"; continue; }
-            if (fields.size() < 3) { std::cerr << "Warning: short line " << ln << " in students.csv\n"; continue; }
-            try {
-                Student s;
-                s.id = std::stoi(fields[0]);
-                s.name = fields[1];
-                s.email = fields[2];
-                if (fields.size() >= 4 && !fields[3].empty()) {
-                    s.pass_hash = static_cast<std::size_t>(std::stoull(fields[3]));
-                }
-                students[s.id] = s;
-                studentsByEmail[s.email] = s.id;
-            } catch (...) { std::cerr << "Warning: bad data at line " << ln << " in students.csv\n"; }
-        }
+        ScopedTimer timer(parseHist);
+        if (!(snapshot_is_fresh() && read_snapshot(snapshotFile))) load_csv_tables();
+        replay_journal();
     }
-    // enrollments.csv: student_id,course_code
-    {
-        std::ifstream ifs(enrollmentsFile);
-        std::string line; int ln=0;
-        while (std::getline(ifs, line)) {
-            ++ln; if (line.empty()) continue;
-            auto fields = csv::parse_line(line);
-            if (fields.size() < 2) { std::cerr << "Warning: malformed line " << ln << " in enrollments.csv\n"; continue; }
-            try {
-                Enrollment e;
-                e.student_id = std::stoi(fields[0]);
-                e.course_code = fields[1];
-                enrollments.push_back(e);
-                enrollmentsByCourse.emplace(e.course_code, e.student_id);
-            } catch (...) { std::cerr << "Warning: bad data at line " << ln << " in enrollments.csv\n"; }
-        }
+    ScopedTimer timer(indexHist);
+    recompute_indices();
+    set_next_ids();
+}
+
+bool Storage::snapshot_is_fresh() const {
+    std::error_code ec;
+    auto snapTime = fs::last_write_time(snapshotFile, ec);
+    if (ec) return false;
+    for (const auto& p : {studentsFile, enrollmentsFile, availabilityFile, sessionsFile, participantsFile}) {
+        auto t = fs::last_write_time(p, ec);
+        if (!ec && t > snapTime) return false;
     }
+    return true;
+}
+
+void Storage::load_csv_tables() {
+    TRACE_SCOPE("Storage::load_csv_tables", "storage");
+    // The five tables are independent until replay and indexing, so every table is
+    // cut into line-aligned chunks and all chunks are parsed on the pool at once.
+    // Merging happens per table (in parallel, each into its own container) and in
+    // file order, so rows and warnings come out exactly as a sequential scan would.
+    ThreadPool& pool = ThreadPool::shared();
+    MappedFile studentsMap(studentsFile), enrollmentsMap(enrollmentsFile), availabilityMap(availabilityFile),
+               sessionsMap(sessionsFile), participantsMap(participantsFile);
+
+    // students.csv: id,name,email,pass_hash?
+    auto stuJobs = start_table<Student>(pool, studentsMap.view(), "parse students.csv", [](const Fields& fields, Student& s) -> const char* {
+        if (fields.size() < 3) return "short line";
+        return student_from_fields(fields, s) ? nullptr : "bad data at line";
+    });
+    // enrollments.csv: student_id,course_code
+    auto enrJobs = start_table<EnrollmentRow>(pool, enrollmentsMap.view(), "parse enrollments.csv", [](const Fields& fields, EnrollmentRow& e) -> const char* {
+        if (fields.size() < 2) return "malformed line";
+        return enrollment_from_fields(fields, e) ? nullptr : "bad data at line";
+    });
     // availability.csv: student_id,day,start,end
-    {
-        std::ifstream ifs(availabilityFile);
-        std::string line; int ln=0;
-        while (std::getline(ifs, line)) {
-            ++ln; if (line.empty()) continue;
-            auto fields = csv::parse_line(line);
-            if (fields.size() < 4) { std::cerr << "Warning: malformed line " << ln << " in availability.csv\n"; continue; }
-            try {
-                Availability a;
-                a.student_id = std::stoi(fields[0]);
-                a.day = std::stoi(fields[1]);
-                a.start = std::stoi(fields[2]);
-                a.end = std::stoi(fields[3]);
-                availability.push_back(a);
-            } catch (...) { std::cerr << "Warning: bad data at line " << ln << " in availability.csv\n"; }
-        }
-    }
+    auto avJobs = start_table<Availability>(pool, availabilityMap.view(), "parse availability.csv", [](const Fields& fields, Availability& a) -> const char* {
+        if (fields.size() < 4) return "malformed line";
+        return availability_from_fields(fields, a) ? nullptr : "bad data at line";
+    });
     // sessions.csv: id,course_code,day,start,duration,organizer_id,status,cancel_reason
-    {
-        std::ifstream ifs(sessionsFile);
-        std::string line; int ln=0;
-        while (std::getline(ifs, line)) {
-            ++ln; if (line.empty()) continue;
-            auto fields = csv::parse_line(line);
-            if (fields.size() < 7) { std::cerr << "Warning: malformed line " << ln << " in sessions.csv\n"; continue; }
-            try {
-                Session s;
-                s.id = std::stoi(fields[0]);
-                s.course_code = fields[1];
-                s.day = std::stoi(fields[2]);
-                s.start = std::stoi(fields[3]);
-                s.duration = std::stoi(fields[4]);
-                s.organizer_id = std::stoi(fields[5]);
-                std::string st = fields[6];
-                if (st == "PROPOSED") s.status = SessionStatus::PROPOSED;
-                else if (st == "CONFIRMED") s.status = SessionStatus::CONFIRMED;
-                else s.status = SessionStatus::CANCELLED;
-                if (fields.size() >= 8 && !fields[7].empty()) s.cancel_reason = fields[7];
-                sessions[s.id] = s;
-            } catch (...) { std::cerr << "Warning: bad data at line " << ln << " in sessions.csv\n"; }
-        }
-    }
+    auto sesJobs = start_table<SessionRow>(pool, sessionsMap.view(), "parse sessions.csv", [](const Fields& fields, SessionRow& s) -> const char* {
+        if (fields.size() < 7) return "malformed line";
+        return session_from_fields(fields, s) ? nullptr : "bad data at line";
+    });
     // session_participants.csv: session_id,student_id,confirmed
-    {
-        std::ifstream ifs(participantsFile);
-        std::string line; int ln=0;
-        while (std::getline(ifs, line)) {
-            ++ln; if (line.empty()) continue;
-            auto fields = csv::parse_line(line);
-            if (fields.size() < 3) { std::cerr << "Warning: malformed line " << ln << " in session_participants.csv\n"; continue; }
-            try {
-                SessionParticipant p;
-                p.session_id = std::stoi(fields[0]);
-                p.student_id = std::stoi(fields[1]);
-                p.confirmed = (fields[2] == "true" || fields[2] == "1");
-                participants.push_back(p);
-            } catch (...) { std::cerr << "Warning: bad data at line " << ln << " in session_participants.csv\n"; }
-        }
-    }
+    auto parJobs = start_table<SessionParticipant>(pool, participantsMap.view(), "parse session_participants.csv", [](const Fields& fields, SessionParticipant& p) -> const char* {
+        if (fields.size() < 3) return "malformed line";
+        return participant_from_fields(fields, p) ? nullptr : "bad data at line";
+    });
 
-    recompute_indices();
-    set_next_ids();
+    auto stuChunks = finish_chunks(stuJobs);
+    auto enrChunks = finish_chunks(enrJobs);
+    auto avChunks = finish_chunks(avJobs);
+    auto sesChunks = finish_chunks(sesJobs);
+    auto parChunks = finish_chunks(parJobs);
+
+    // Enrollments and sessions share the course dictionary, so they merge in one task.
+    std::string warnings[5];
+    std::future<void> merges[4] = {
+        pool.submit([&]{
+            TRACE_SCOPE("merge students.csv", "storage");
+            students.reserve(total_rows(stuChunks));
+            warnings[0] = merge_chunks(stuChunks, "students.csv", [&](Student&& s){ int id = s.id; students[id] = std::move(s); });
+        }),
+        pool.submit([&]{
+            TRACE_SCOPE("merge enrollments.csv + sessions.csv", "storage");
+            warnings[1] = merge_chunks(enrChunks, "enrollments.csv", [&](EnrollmentRow&& e){
+                enrollmentsByStudent[e.student_id].push_back(Enrollment{e.student_id, courses.intern(e.course_code)});
+            });
+            sessions.reserve(total_rows(sesChunks));
+            warnings[3] = merge_chunks(sesChunks, "sessions.csv", [&](SessionRow&& r){
+                r.session.course_id = courses.intern(r.course_code);
+                int id = r.session.id;
+                sessions[id] = std::move(r.session);
+            });
+        }),
+        pool.submit([&]{
+            TRACE_SCOPE("merge availability.csv", "storage");
+            warnings[2] = merge_chunks(avChunks, "availability.csv", [&](Availability&& a){ availabilityByStudent[a.student_id].push_back(a); });
+        }),
+        pool.submit([&]{
+            TRACE_SCOPE("merge session_participants.csv", "storage");
+            warnings[4] = merge_chunks(parChunks, "session_participants.csv", [&](SessionParticipant&& p){ participantsBySession[p.session_id].push_back(p); });
+        }),
+    };
+    for (auto& m : merges) m.get();
+    for (const auto& w : warnings) std::cerr << w;
 }
 
-void Storage::save_students() {
+bool Storage::save_students() {
+    TRACE_SCOPE("Storage::save_students", "storage");
+    ScopedTimer timer(save_histogram());
     std::vector<std::string> lines;
     lines.reserve(students.size());
     for (const auto& kv : students) {
-        const Student& s = kv.second;
-        std::string hashStr = s.pass_hash ? std::to_string(*s.pass_hash) : "";
-        lines.push_back(csv::join_fields({std::to_string(s.id), s.name, s.email, hashStr}));
+        lines.push_back(csv::join_fields(student_to_fields(kv.second)));
     }
-    atomic_write(studentsFile, lines);
+    return atomic_write(studentsFile, lines);
 }
 
-void Storage::save_enrollments() {
+bool Storage::save_enrollments() {
+    TRACE_SCOPE("Storage::save_enrollments", "storage");
+    ScopedTimer timer(save_histogram());
     std::vector<std::string> lines;
-    lines.reserve(enrollments.size());
-    for (const auto& e : enrollments) {
-        lines.push_back(csv::join_fields({std::to_string(e.student_id), e.course_code}));
+    lines.reserve(enrollmentsByStudent.size());
+    for (const auto& kv : enrollmentsByStudent) {
+        for (const auto& e : kv.second) {
+            lines.push_back(csv::join_fields({std::to_string(e.student_id), courses.code(e.course_id)}));
+        }
     }
-    atomic_write(enrollmentsFile, lines);
+    return atomic_write(enrollmentsFile, lines);
 }
 
-void Storage::save_availability() {
+bool Storage::save_availability() {
+    TRACE_SCOPE("Storage::save_availability", "storage");
+    ScopedTimer timer(save_histogram());
     std::vector<std::string> lines;
-    lines.reserve(availability.size());
-    for (const auto& a : availability) {
-        lines.push_back(csv::join_fields({std::to_string(a.student_id), std::to_string(a.day),
-                                          std::to_string(a.start), std::to_string(a.end)}));
+    lines.reserve(availabilityByStudent.size());
+    for (const auto& kv : availabilityByStudent) {
+        for (const auto& a : kv.second) lines.push_back(csv::join_fields(availability_to_fields(a)));
     }
-    atomic_write(availabilityFile, lines);
+    return atomic_write(availabilityFile, lines);
 }
 
-void Storage::save_sessions() {
+bool Storage::save_sessions() {
+    TRACE_SCOPE("Storage::save_sessions", "storage");
+    ScopedTimer timer(save_histogram());
     std::vector<std::string> lines;
     lines.reserve(sessions.size());
     for (const auto& kv : sessions) {
-        const Session& s = kv.second;
-        std::string statusStr = (s.status == SessionStatus::PROPOSED) ? "PROPOSED"
-                               : (s.status == SessionStatus::CONFIRMED) ? "CONFIRMED" : "CANCELLED";
-        std::string cancelStr = s.cancel_reason ? *s.cancel_reason : "";
-        lines.push_back(csv::join_fields({
-            std::to_string(s.id), s.course_code, std::to_string(s.day), std::to_string(s.start),
-            std::to_string(s.duration), std::to_string(s.organizer_id), statusStr, cancelStr
-        }));
+        lines.push_back(csv::join_fields(session_to_fields(kv.second, courses.code(kv.second.course_id))));
     }
-    atomic_write(sessionsFile, lines);
+    return atomic_write(sessionsFile, lines);
 }
 
-void Storage::save_participants() {
+bool Storage::save_participants() {
+    TRACE_SCOPE("Storage::save_participants", "storage");
+    ScopedTimer timer(save_histogram());
     std::vector<std::string> lines;
-    lines.reserve(participants.size());
-    for (const auto& p : participants) {
-        lines.push_back(csv::join_fields({std::to_string(p.session_id), std::to_string(p.student_id),
-                                          p.confirmed ? "true" : "false"}));
+    lines.reserve(participantsBySession.size());
+    for (const auto& kv : participantsBySession) {
+        for (const auto& p : kv.second) lines.push_back(csv::join_fields(participant_to_fields(p)));
     }
-    atomic_write(participantsFile, lines);
+    return atomic_write(participantsFile, lines);
 }
 
 void Storage::recompute_indices() {
+    TRACE_SCOPE("Storage::recompute_indices", "storage");
     studentsByEmail.clear();
     for (const auto& kv : students) {
         studentsByEmail[kv.second.email] = kv.first;
     }
     enrollmentsByCourse.clear();
-    for (const auto& e : enrollments) {
-        enrollmentsByCourse.emplace(e.course_code, e.student_id);
+    for (const auto& kv : enrollmentsByStudent) {
+        for (const auto& e : kv.second) enrollmentsByCourse[e.course_id].push_back(e.student_id);
+    }
+    availabilityMasks.clear();
+    for (const auto& kv : availabilityByStudent) {
+        for (const auto& a : kv.second) set_hours(availabilityMasks[a.student_id], a.day, a.start, a.end);
+    }
+    sessionsByStudent.clear();
+    for (const auto& kv : sessions) link_session(kv.second.organizer_id, kv.first);
+    for (const auto& kv : participantsBySession) {
+        for (const auto& p : kv.second) link_session(p.student_id, p.session_id);
+    }
+    busyMasks.clear();
+    for (const auto& kv : sessions) mark_busy(kv.second);
+}
+
+bool Storage::add_enrollment(const Enrollment& e) {
+    auto& mine = enrollmentsByStudent[e.student_id];
+    for (const auto& x : mine) if (x.course_id == e.course_id) return false;
+    mine.push_back(e);
+    enrollmentsByCourse[e.course_id].push_back(e.student_id);
+    if (txnDepth > 0) undoLog.push_back([this, e]{ remove_enrollment(e.student_id, e.course_id); });
+    return true;
+}
+
+bool Storage::remove_enrollment(int student_id, int course_id) {
+    auto it = enrollmentsByStudent.find(student_id);
+    if (it == enrollmentsByStudent.end()) return false;
+    auto& mine = it->second;
+    auto pos = std::find_if(mine.begin(), mine.end(), [&](const Enrollment& e){ return e.course_id == course_id; });
+    if (pos == mine.end()) return false;
+    mine.erase(pos);
+    if (mine.empty()) enrollmentsByStudent.erase(it);
+    auto& members = enrollmentsByCourse[course_id];
+    auto m = std::find(members.begin(), members.end(), student_id);
+    if (m != members.end()) { *m = members.back(); members.pop_back(); }
+    if (txnDepth > 0) undoLog.push_back([this, student_id, course_id]{ add_enrollment(Enrollment{student_id, course_id}); });
+    return true;
+}
+
+void Storage::upsert_participant(const SessionParticipant& p) {
+    auto& list = participantsBySession[p.session_id];
+    for (auto& x : list) {
+        if (x.student_id == p.student_id) { x.confirmed = p.confirmed; return; }
+    }
+    list.push_back(p);
+    link_session(p.student_id, p.session_id);
+}
+
+void Storage::link_session(int student_id, int session_id) {
+    auto& ids = sessionsByStudent[student_id];
+    if (std::find(ids.begin(), ids.end(), session_id) == ids.end()) ids.push_back(session_id);
+}
+
+std::optional<int> Storage::student_by_email(std::string_view email) const {
+    thread_local std::string key; // reused, so a lookup allocates only for a longer email than before
+    key.assign(email);
+    auto it = studentsByEmail.find(key);
+    if (it == studentsByEmail.end()) return std::nullopt;
+    return it->second;
+}
+
+const std::vector<Enrollment>& Storage::enrollments_of(int student_id) const {
+    static const std::vector<Enrollment> none;
+    auto it = enrollmentsByStudent.find(student_id);
+    return it == enrollmentsByStudent.end() ? none : it->second;
+}
+
+const std::vector<Availability>& Storage::availability_of(int student_id) const {
+    static const std::vector<Availability> none;
+    auto it = availabilityByStudent.find(student_id);
+    return it == availabilityByStudent.end() ? none : it->second;
+}
+
+const std::vector<SessionParticipant>& Storage::participants_of(int session_id) const {
+    static const std::vector<SessionParticipant> none;
+    auto it = participantsBySession.find(session_id);
+    return it == participantsBySession.end() ? none : it->second;
+}
+
+const std::vector<int>& Storage::students_in(int course_id) const {
+    static const std::vector<int> none;
+    auto it = enrollmentsByCourse.find(course_id);
+    return it == enrollmentsByCourse.end() ? none : it->second;
+}
+
+const std::vector<int>& Storage::sessions_of(int student_id) const {
+    static const std::vector<int> none;
+    auto it = sessionsByStudent.find(student_id);
+    return it == sessionsByStudent.end() ? none : it->second;
+}
+
+void Storage::mark_busy(const Session& s) {
+    if (s.status != SessionStatus::CONFIRMED || s.day < 0 || s.day >= kDaysPerWeek
+        || s.start < 0 || s.start >= kHoursPerDay) return;
+    std::size_t bit = week_bit(s.day, s.start);
+    busyMasks[s.organizer_id].set(bit);
+    for (const auto& p : participants_of(s.id)) {
+        if (p.confirmed) busyMasks[p.student_id].set(bit);
     }
 }
 
+void Storage::recompute_busy(int student_id) {
+    WeekMask busy;
+    for (int sid : sessions_of(student_id)) {
+        auto it = sessions.find(sid);
+        if (it == sessions.end()) continue;
+        const Session& s = it->second;
+        if (s.status != SessionStatus::CONFIRMED || s.day < 0 || s.day >= kDaysPerWeek
+            || s.start < 0 || s.start >= kHoursPerDay) continue;
+        bool booked = s.organizer_id == student_id;
+        for (const auto& p : participants_of(sid)) {
+            if (p.student_id == student_id && p.confirmed) booked = true;
+        }
+        if (booked) busy.set(week_bit(s.day, s.start));
+    }
+    if (busy.none()) busyMasks.erase(student_id);
+    else busyMasks[student_id] = busy;
+}
+
+const WeekMask& Storage::busy_mask(int student_id) const {
+    static const WeekMask empty;
+    auto it = busyMasks.find(student_id);
+    return it == busyMasks.end() ? empty : it->second;
+}
+
+const WeekMask& Storage::availability_mask(int student_id) const {
+    static const WeekMask empty;
+    auto it = availabilityMasks.find(student_id);
+    return it == availabilityMasks.end() ? empty : it->second;
+}
+
 void Storage::set_next_ids() {
     int maxStu = 0;
     for (const auto& kv : students) if (kv.first > maxStu) maxStu = kv.first;
-    nextStudentId = maxStu + 1;
+    nextStudentId = std::max(nextStudentId, maxStu + 1);
 
     int maxSess = 0;
     for (const auto& kv : sessions) if (kv.first > maxSess) maxSess = kv.first;
-    nextSessionId = maxSess + 1;
+    nextSessionId = std::max(nextSessionId, maxSess + 1);
+}
+
+// journal.log: one CSV record per mutation, tagged with the table it touches.
+// Every record states the final value of one key, so replaying it over a snapshot
+// that already contains some of its effects (e.g. after a crash mid-compaction) is safe.
+unsigned Storage::table_of(std::string_view tag) {
+    if (tag == "student") return kStudentsTable;
+    if (tag == "enroll" || tag == "unenroll") return kEnrollmentsTable;
+    if (tag == "avail" || tag == "unavail") return kAvailabilityTable;
+    if (tag == "session") return kSessionsTable;
+    return kParticipantsTable;
+}
+
+bool Storage::append_journal(const std::vector<std::string>& fields) {
+    std::string line = csv::join_fields(fields) + "\n";
+    if (txnDepth > 0) {
+        txnBuffer += line;
+        ++txnRecords;
+        txnTables |= table_of(fields[0]);
+        return true;
+    }
+    return write_journal(line, 1, table_of(fields[0]));
+}
+
+// A table is dirty only once its records are in the journal. Records whose append
+// fails later in the asynchronous modes are caught by the worker (appends_lost()).
+bool Storage::write_journal(const std::string& lines, std::size_t records, unsigned tables) {
+    if (!persist->append(lines)) return false;
+    journalRecords += records;
+    dirtyTables |= tables;
+    return true;
+}
+
+Storage::Transaction::Transaction(Storage& s)
+    : store(s), outermost(s.txnDepth == 0), nextStudentId(s.nextStudentId), nextSessionId(s.nextSessionId),
+      courseCount(s.courses.size()) {
+    ++store.txnDepth;
+}
+
+Storage::Transaction::~Transaction() {
+    if (done) return;
+    --store.txnDepth;
+    if (!outermost) return;
+    store.txnBuffer.clear();
+    store.txnRecords = 0;
+    store.txnTables = 0;
+    rollback();
+}
+
+bool Storage::Transaction::commit() {
+    if (done) return true;
+    done = true;
+    --store.txnDepth;
+    if (!outermost) return true;
+    std::string lines;
+    lines.swap(store.txnBuffer);
+    std::size_t records = store.txnRecords;
+    unsigned tables = store.txnTables;
+    store.txnRecords = 0;
+    store.txnTables = 0;
+    if (records == 0 || store.write_journal(lines, records, tables)) {
+        store.undoLog.clear();
+        return true;
+    }
+    rollback(); // the changes never reached disk; drop them from memory too
+    return false;
+}
+
+// Newest change first, so each entry sees the state its change left behind.
+void Storage::Transaction::rollback() {
+    TRACE_SCOPE("Storage::Transaction::rollback", "storage");
+    for (auto it = store.undoLog.rbegin(); it != store.undoLog.rend(); ++it) (*it)();
+    store.undoLog.clear();
+    store.nextStudentId = nextStudentId;
+    store.nextSessionId = nextSessionId;
+    store.courses.truncate(courseCount);
+}
+
+void Storage::undo_student(int student_id) {
+    if (txnDepth == 0) return;
+    std::optional<Student> before;
+    auto it = students.find(student_id);
+    if (it != students.end()) before = it->second;
+    undoLog.push_back([this, student_id, before]{
+        auto cur = students.find(student_id);
+        if (cur != students.end()) {
+            studentsByEmail.erase(cur->second.email);
+            students.erase(cur);
+        }
+        if (before) {
+            students[student_id] = *before;
+            studentsByEmail[before->email] = student_id;
+        }
+    });
+}
+
+void Storage::undo_availability(int student_id) {
+    if (txnDepth == 0) return;
+    auto slots = availabilityByStudent.find(student_id);
+    auto mask = availabilityMasks.find(student_id);
+    std::optional<std::vector<Availability>> before;
+    std::optional<WeekMask> beforeMask;
+    if (slots != availabilityByStudent.end()) before = slots->second;
+    if (mask != availabilityMasks.end()) beforeMask = mask->second;
+    undoLog.push_back([this, student_id, before, beforeMask]{
+        if (before) availabilityByStudent[student_id] = *before;
+        else availabilityByStudent.erase(student_id);
+        if (beforeMask) availabilityMasks[student_id] = *beforeMask;
+        else availabilityMasks.erase(student_id);
+    });
+}
+
+void Storage::undo_session(int session_id) {
+    if (txnDepth == 0) return;
+    std::optional<Session> before;
+    std::optional<std::vector<SessionParticipant>> beforeMembers;
+    auto it = sessions.find(session_id);
+    auto members = participantsBySession.find(session_id);
+    if (it != sessions.end()) before = it->second;
+    if (members != participantsBySession.end()) beforeMembers = members->second;
+    undoLog.push_back([this, session_id, before, beforeMembers]{
+        // Everyone linked to the session now or before it changed: their
+        // sessionsByStudent entry and busy hours may need fixing.
+        std::vector<int> affected;
+        auto note = [&](int student_id) {
+            if (std::find(affected.begin(), affected.end(), student_id) == affected.end()) affected.push_back(student_id);
+        };
+        auto cur = sessions.find(session_id);
+        if (cur != sessions.end()) note(cur->second.organizer_id);
+        for (const auto& p : participants_of(session_id)) note(p.student_id);
+        if (before) note(before->organizer_id);
+        if (beforeMembers) for (const auto& p : *beforeMembers) note(p.student_id);
+
+        if (before) sessions[session_id] = *before;
+        else sessions.erase(session_id);
+        if (beforeMembers) participantsBySession[session_id] = *beforeMembers;
+        else participantsBySession.erase(session_id);
+
+        for (int student_id : affected) {
+            bool linked = false;
+            for (const auto& p : participants_of(session_id)) linked = linked || p.student_id == student_id;
+            if (linked) {
+                link_session(student_id, session_id);
+            } else {
+                auto ids = sessionsByStudent.find(student_id);
+                if (ids != sessionsByStudent.end()) {
+                    ids->second.erase(std::remove(ids->second.begin(), ids->second.end(), session_id), ids->second.end());
+                    if (ids->second.empty()) sessionsByStudent.erase(ids);
+                }
+            }
+            recompute_busy(student_id);
+        }
+    });
+}
+
+void Storage::maybe_compact() {
+    if (journalRecords >= compactThreshold) compact();
+}
+
+bool Storage::journal_student(const Student& s) {
+    auto fields = student_to_fields(s);
+    fields.insert(fields.begin(), "student");
+    return append_journal(fields);
+}
+
+bool Storage::journal_enrollment(const Enrollment& e, bool added) {
+    return append_journal({added ? "enroll" : "unenroll", std::to_string(e.student_id), courses.code(e.course_id)});
+}
+
+bool Storage::journal_availability(const Availability& a, bool added) {
+    auto fields = availability_to_fields(a);
+    fields.insert(fields.begin(), added ? "avail" : "unavail");
+    return append_journal(fields);
+}
+
+bool Storage::journal_session(const Session& s) {
+    auto fields = session_to_fields(s, courses.code(s.course_id));
+    fields.insert(fields.begin(), "session");
+    return append_journal(fields);
+}
+
+bool Storage::journal_participant(const SessionParticipant& p) {
+    auto fields = participant_to_fields(p);
+    fields.insert(fields.begin(), "participant");
+    return append_journal(fields);
+}
+
+// Each record touches only the rows of its own key (one student's enrollments or slots,
+// one session's participants), so replay is linear in the journal. The derived indexes
+// are not maintained here; load_all rebuilds them all afterwards.
+void Storage::replay_journal() {
+    TRACE_SCOPE("Storage::replay_journal", "storage");
+    journalRecords = 0;
+    dirtyTables = 0;
+    scan_csv(journalFile, "journal.log", [&](const Fields& fields, int ln){
+        if (fields.size() < 3) { std::cerr << "Warning: malformed line " << ln << " in journal.log\n"; return; }
+        std::string_view tag = fields[0];
+        bool ok = true;
+        if (tag == "student" && fields.size() >= 4) {
+            Student s;
+            if ((ok = student_from_fields(fields, s, 1))) students[s.id] = std::move(s);
+        } else if (tag == "enroll" || tag == "unenroll") {
+            EnrollmentRow e;
+            if ((ok = enrollment_from_fields(fields, e, 1))) {
+                int cid = courses.intern(e.course_code);
+                auto& mine = enrollmentsByStudent[e.student_id];
+                auto pos = std::find_if(mine.begin(), mine.end(), [&](const Enrollment& x){ return x.course_id == cid; });
+                if (tag == "enroll" && pos == mine.end()) mine.push_back(Enrollment{e.student_id, cid});
+                else if (tag == "unenroll" && pos != mine.end()) mine.erase(pos);
+            }
+        } else if ((tag == "avail" || tag == "unavail") && fields.size() >= 5) {
+            Availability a;
+            if ((ok = availability_from_fields(fields, a, 1))) {
+                auto& mine = availabilityByStudent[a.student_id];
+                auto same = [&](const Availability& x){ return x.day == a.day && x.start == a.start && x.end == a.end; };
+                mine.erase(std::remove_if(mine.begin(), mine.end(), same), mine.end());
+                if (tag == "avail") mine.push_back(a);
+            }
+        } else if (tag == "session" && fields.size() >= 8) {
+            SessionRow r;
+            if ((ok = session_from_fields(fields, r, 1))) {
+                r.session.course_id = courses.intern(r.course_code);
+                sessions[r.session.id] = std::move(r.session);
+            }
+        } else if (tag == "participant" && fields.size() >= 4) {
+            SessionParticipant p;
+            if ((ok = participant_from_fields(fields, p, 1))) {
+                auto& list = participantsBySession[p.session_id];
+                auto pos = std::find_if(list.begin(), list.end(), [&](const SessionParticipant& x){ return x.student_id == p.student_id; });
+                if (pos == list.end()) list.push_back(p);
+                else pos->confirmed = p.confirmed;
+            }
+        } else {
+            std::cerr << "Warning: malformed line " << ln << " in journal.log\n"; return;
+        }
+        if (!ok) { std::cerr << "Warning: bad data at line " << ln << " in journal.log\n"; return; }
+        dirtyTables |= table_of(tag);
+        ++journalRecords;
+    });
+}
+
+bool Storage::compact() {
+    TRACE_SCOPE("Storage::compact", "storage");
+    // Files an earlier compaction could not replace are rewritten too, even if no
+    // journal record touched them since; the journal is truncated once none is left.
+    // After a lost journal append every table is rewritten, since memory is the only
+    // copy of that record.
+    bool retrySnapshot = false;
+    if (persist->appends_lost()) dirtyTables = kAllTables;
+    for (const auto& path : persist->failed_replaces()) {
+        if (path == studentsFile) dirtyTables |= kStudentsTable;
+        else if (path == enrollmentsFile) dirtyTables |= kEnrollmentsTable;
+        else if (path == availabilityFile) dirtyTables |= kAvailabilityTable;
+        else if (path == sessionsFile) dirtyTables |= kSessionsTable;
+        else if (path == participantsFile) dirtyTables |= kParticipantsTable;
+        else if (path == snapshotFile) retrySnapshot = true;
+    }
+    bool rewroteAll = dirtyTables == kAllTables;
+    unsigned failed = 0;
+    auto save = [&](unsigned table, bool (Storage::*write)()) {
+        if ((dirtyTables & table) && !(this->*write)()) failed |= table;
+    };
+    save(kStudentsTable, &Storage::save_students);
+    save(kEnrollmentsTable, &Storage::save_enrollments);
+    save(kAvailabilityTable, &Storage::save_availability);
+    save(kSessionsTable, &Storage::save_sessions);
+    save(kParticipantsTable, &Storage::save_participants);
+    if (failed) {
+        // The journal is the only copy of those tables' changes: keep it, and rewrite
+        // the tables that failed at the next compaction.
+        dirtyTables = failed;
+        std::cerr << "[ERROR] IO_WRITE: table rewrite failed; keeping " << journalFile.string() << "\n";
+        return false;
+    }
+    dirtyTables = 0;
+    if (retrySnapshot || fs::exists(snapshotFile)) write_snapshot(snapshotFile);
+    persist->truncate_journal(rewroteAll);
+    if (persist->mode() == Durability::Fsync) persist->drain();
+    journalRecords = 0;
+    return true;
 }
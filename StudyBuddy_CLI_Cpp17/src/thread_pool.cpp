@@ -0,0 +1,83 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace {
+// Which pool and worker the current thread belongs to, so nested submits stay local.
+thread_local const ThreadPool* tlsPool = nullptr;
+thread_local std::size_t tlsWorker = 0;
+}
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    queues.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) queues.push_back(std::make_unique<WorkQueue>());
+    workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) workers.emplace_back([this, i]{ worker_loop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    std::size_t target = tlsPool == this ? tlsWorker : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        // Counted before the push (so it never underflows) and under sleepMtx (so a
+        // worker checking the wait predicate cannot miss it).
+        std::lock_guard<std::mutex> lock(sleepMtx);
+        ++pending;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mtx);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    cv.notify_one();
+}
+
+bool ThreadPool::try_pop(std::size_t self, std::function<void()>& task) {
+    {
+        WorkQueue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (std::size_t k = 1; k < queues.size(); ++k) {
+        WorkQueue& victim = *queues[(self + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(std::size_t self) {
+    tlsPool = this;
+    tlsWorker = self;
+    while (true) {
+        std::function<void()> task;
+        if (try_pop(self, task)) {
+            --pending;
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMtx);
+        cv.wait(lock, [this]{ return stopping || pending > 0; });
+        if (stopping && pending == 0) return; // stopping and drained
+    }
+}
@@ -0,0 +1,151 @@
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+    const char* name;
+    const char* category;
+    std::int64_t begin_ns; // since the trace epoch
+    std::int64_t dur_ns;
+};
+
+// One per thread that has recorded a span. Owned by the registry, so the events of
+// threads that have exited (server connections) are still written.
+struct ThreadBuffer {
+    int tid;
+    std::mutex mtx; // taken only by the owning thread, and by write()/dropped()/start()
+    std::vector<Event> events;
+    std::size_t finished{0}; // spans ended on this thread since start(), kept or not
+    std::size_t quota{0};    // spans this thread may still keep before claiming more
+};
+
+// Threads claim their share of the span limit in blocks, so keeping or dropping a span
+// touches shared state only once per block.
+constexpr std::size_t kClaimBlock = 256;
+
+std::atomic<bool> gEnabled{false};
+std::atomic<std::size_t> gLimit{trace::kDefaultSpanLimit};
+std::atomic<std::size_t> gActiveLimit{trace::kDefaultSpanLimit}; // gLimit as of start()
+std::atomic<std::size_t> gUnclaimed{trace::kDefaultSpanLimit};   // part of it no thread has claimed
+std::mutex gRegistryMtx;
+std::vector<std::shared_ptr<ThreadBuffer>> gBuffers;
+Clock::time_point gEpoch = Clock::now();
+
+ThreadBuffer& local_buffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = []{
+        auto b = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(gRegistryMtx);
+        b->tid = static_cast<int>(gBuffers.size()) + 1;
+        b->events.reserve(1024);
+        gBuffers.push_back(b);
+        return b;
+    }();
+    return *buffer;
+}
+
+void write_escaped(std::ostream& os, const char* s) {
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') os << '\\';
+        os << *s;
+    }
+}
+
+} // namespace
+
+namespace trace {
+
+void start() {
+    {
+        std::lock_guard<std::mutex> lock(gRegistryMtx);
+        for (auto& b : gBuffers) {
+            std::lock_guard<std::mutex> bl(b->mtx);
+            b->events.clear();
+            b->finished = 0;
+            b->quota = 0;
+        }
+        gEpoch = Clock::now();
+        gActiveLimit = gLimit.load();
+        gUnclaimed = gActiveLimit.load();
+    }
+    gEnabled.store(true, std::memory_order_release);
+}
+
+void stop() { gEnabled.store(false, std::memory_order_release); }
+
+bool enabled() { return gEnabled.load(std::memory_order_relaxed); }
+
+void set_span_limit(std::size_t spans) { gLimit.store(spans); }
+
+std::size_t span_limit() { return gLimit.load(); }
+
+std::size_t dropped() {
+    std::size_t n = 0;
+    std::lock_guard<std::mutex> lock(gRegistryMtx);
+    for (auto& b : gBuffers) {
+        std::lock_guard<std::mutex> bl(b->mtx);
+        n += b->finished - b->events.size();
+    }
+    return n;
+}
+
+bool write(const std::filesystem::path& path) {
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (!ofs) return false;
+    ofs << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"span_limit\":" << gActiveLimit.load()
+        << ",\"dropped_spans\":" << dropped() << "},\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(gRegistryMtx);
+    for (auto& b : gBuffers) {
+        std::lock_guard<std::mutex> bl(b->mtx);
+        if (b->events.empty()) continue;
+        ofs << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid
+            << ",\"args\":{\"name\":\"thread " << b->tid << "\"}}";
+        first = false;
+        for (const Event& e : b->events) {
+            ofs << ",\n{\"name\":\"";
+            write_escaped(ofs, e.name);
+            ofs << "\",\"cat\":\"";
+            write_escaped(ofs, e.category);
+            // Timestamps are microseconds; three decimals keep nanosecond resolution.
+            ofs << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid
+                << ",\"ts\":" << static_cast<double>(e.begin_ns) / 1e3 << ",\"dur\":" << static_cast<double>(e.dur_ns) / 1e3 << "}";
+        }
+    }
+    ofs << "\n]}\n";
+    return static_cast<bool>(ofs);
+}
+
+Span::Span(const char* n, const char* c): name(n), category(c), active(gEnabled.load(std::memory_order_acquire)) {
+    if (active) begin = Clock::now();
+}
+
+Span::~Span() {
+    if (!active) return;
+    auto end = Clock::now();
+    ThreadBuffer& b = local_buffer();
+    std::lock_guard<std::mutex> lock(b.mtx);
+    ++b.finished;
+    if (b.quota == 0) {
+        std::size_t left = gUnclaimed.load(std::memory_order_relaxed), take;
+        do {
+            take = std::min(left, kClaimBlock);
+        } while (take != 0 && !gUnclaimed.compare_exchange_weak(left, left - take, std::memory_order_relaxed));
+        b.quota = take;
+    }
+    if (b.quota == 0) return; // counted in dropped()
+    --b.quota;
+    b.events.push_back(Event{name, category,
+                             std::chrono::duration_cast<std::chrono::nanoseconds>(begin - gEpoch).count(),
+                             std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()});
+}
+
+} // namespace trace
@@ -1,16 +1,45 @@
-
 #include "validation.h"
-#include <regex>
 
-bool is_valid_email(const std::string& email) {
-    // Simple heuristic: something@something.something
-    static const std::regex re(R"(^[^@\s]+@[^@\s]+\.[^@\s]+$)");
-    return std::regex_match(email, re);
+// Both checks were std::regex_match calls; these scans accept exactly the same strings
+// (tests/test_runner.cpp T39 compares them against the regexes). "Whitespace" is \s in
+// the classic locale: space, \t, \n, \v, \f, \r.
+
+static bool is_regex_space(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static bool is_upper(char c) { return c >= 'A' && c <= 'Z'; }
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+bool is_valid_email(std::string_view email) {
+    // ^[^@\s]+@[^@\s]+\.[^@\s]+$ : exactly one '@' with something before it, no
+    // whitespace anywhere, and a '.' in the domain with something on both sides.
+    std::size_t at = std::string_view::npos;
+    for (std::size_t i = 0; i < email.size(); ++i) {
+        char c = email[i];
+        if (is_regex_space(c)) return false;
+        if (c == '@') {
+            if (at != std::string_view::npos) return false;
+            at = i;
+        }
+    }
+    if (at == std::string_view::npos || at == 0) return false;
+    std::string_view domain = email.substr(at + 1);
+    if (domain.size() < 3) return false;
+    return domain.substr(1, domain.size() - 2).find('.') != std::string_view::npos;
 }
 
-bool is_valid_course(const std::string& code) {
-    static const std::regex re(R"(^[A-Z]{2,5} [0-9]{3,4}$)");
-    return std::regex_match(code, re);
+bool is_valid_course(std::string_view code) {
+    // ^[A-Z]{2,5} [0-9]{3,4}$
+    std::size_t letters = 0;
+    while (letters < code.size() && is_upper(code[letters])) ++letters;
+    if (letters < 2 || letters > 5 || letters >= code.size() || code[letters] != ' ') return false;
+    std::size_t digits = code.size() - letters - 1;
+    if (digits < 3 || digits > 4) return false;
+    for (std::size_t i = letters + 1; i < code.size(); ++i) {
+        if (!is_digit(code[i])) return false;
+    }
+    return true;
 }
 
 bool is_valid_day(int d) { return 0 <= d && d <= 6; }
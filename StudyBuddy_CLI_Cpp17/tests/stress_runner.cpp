@@ -0,0 +1,142 @@
+// Concurrency stress test for the daemon's locking model: reader and writer threads
+// drive CLI::run_command on one shared CLI, each with its own Client, the way
+// Server connections do. Build with `make tsan` to run it under ThreadSanitizer.
+//
+// 1. Mixed phase: writers add/remove courses and availability and schedule sessions
+//    while readers search and list. Afterwards every index must agree with its table.
+// 2. Read scaling: read-only commands on 1, 2, 4 and 8 threads, reported as ops/s.
+//
+// Exit status is 1 if an invariant does not hold.
+#include "cli.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const char* kCourses[] = {"CPSC 1010", "CPSC 2120", "MATH 1060", "ENGL 1030", "PHYS 1220"};
+static constexpr int kCourseCount = 5;
+static constexpr int kStudents = 120;
+
+static std::string course_flag(int i) { return std::string("--course \"") + kCourses[i % kCourseCount] + "\""; }
+static std::string email_of(int i) { return "s" + std::to_string(i) + "@clemson.edu"; }
+
+// A session on the shared CLI with its output discarded.
+struct Actor {
+    CLI& cli;
+    CLI::Client client;
+    std::ostringstream sink;
+
+    explicit Actor(CLI& c): cli(c) { client.out = &sink; client.errs = &sink; }
+    bool run(const std::string& line) {
+        bool ok = cli.run_command(client, line);
+        sink.str("");
+        return ok;
+    }
+};
+
+static void seed(CLI& cli) {
+    Actor s(cli);
+    for (int i = 0; i < kStudents; ++i) {
+        s.run("create_profile --name \"Student " + std::to_string(i) + "\" --email " + email_of(i));
+        s.run("add_course --code \"" + std::string(kCourses[i % kCourseCount]) + "\"");
+        s.run("add_course --code \"" + std::string(kCourses[(i + 2) % kCourseCount]) + "\"");
+        int day = i % 7;
+        s.run("add_availability --day " + std::to_string(day) + " --start " + std::to_string(8 + i % 6) + " --end " + std::to_string(14 + i % 6));
+        s.run("add_availability --day " + std::to_string((day + 3) % 7) + " --start 9 --end 17");
+    }
+}
+
+static void writer(CLI& cli, int w, int iterations) {
+    Actor s(cli);
+    int me = w * 7 % kStudents;
+    s.run("login --email " + email_of(me));
+    for (int i = 0; i < iterations; ++i) {
+        std::string day = std::to_string(i % 7);
+        s.run("add_availability --day " + day + " --start 18 --end 21");
+        s.run("remove_availability --day " + day + " --start 19 --end 20");
+        s.run("add_course --code \"" + std::string(kCourses[(me + 1) % kCourseCount]) + "\"");
+        s.run("schedule_session " + course_flag(me) + " --day " + std::to_string(me % 7) + " --start 10 --invite " + std::to_string(me + 1 + kCourseCount));
+        s.run("remove_course --code \"" + std::string(kCourses[(me + 1) % kCourseCount]) + "\"");
+    }
+}
+
+static void reader(CLI& cli, int r, int iterations) {
+    Actor s(cli);
+    int me = (r * 13 + 3) % kStudents;
+    s.run("login --email " + email_of(me));
+    for (int i = 0; i < iterations; ++i) {
+        s.run("search_matches " + course_flag(me));
+        s.run("search_matches " + course_flag(me) + " --top 5 --prefer 1,3");
+        s.run("find_common_slots " + course_flag(me) + " --with " + std::to_string((me + kCourseCount) % kStudents + 1));
+        s.run("list_sessions");
+        s.run("list_invitations");
+        s.run("list_availability");
+    }
+}
+
+// Every secondary index must match the primary rows it is derived from.
+static bool check_indices(Storage& store, std::string& why) {
+    for (const auto& kv : store.enrollmentsByStudent) {
+        for (const auto& e : kv.second) {
+            const auto& in = store.students_in(e.course_id);
+            if (std::find(in.begin(), in.end(), kv.first) == in.end()) { why = "enrollmentsByCourse misses a row"; return false; }
+        }
+    }
+    for (const auto& kv : store.availabilityByStudent) {
+        WeekMask mask;
+        for (const auto& a : kv.second) set_hours(mask, a.day, a.start, a.end);
+        if (mask != store.availability_mask(kv.first)) { why = "availability mask differs from slots"; return false; }
+    }
+    for (const auto& kv : store.sessions) {
+        if (store.participants_of(kv.first).empty()) { why = "session without participants"; return false; }
+    }
+    return true;
+}
+
+int main() {
+    const std::string dir = "test_data_stress";
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir, ec);
+    int status = 0;
+    {
+        CLI cli(dir, Durability::None);
+        seed(cli);
+
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int w = 0; w < 2; ++w) threads.emplace_back(writer, std::ref(cli), w, 40);
+        for (int r = 0; r < 4; ++r) threads.emplace_back(reader, std::ref(cli), r, 40);
+        for (auto& t : threads) t.join();
+        double mixedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+        std::string why;
+        bool consistent = check_indices(cli.storage(), why);
+        std::cout << "mixed: 2 writers + 4 readers in " << mixedMs << " ms, indices "
+                  << (consistent ? "consistent" : "BROKEN: " + why) << "\n";
+        if (!consistent) status = 1;
+
+        constexpr int kReadOps = 3000; // per thread
+        double base = 0;
+        for (int n : {1, 2, 4, 8}) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> pool;
+            for (int r = 0; r < n; ++r) pool.emplace_back(reader, std::ref(cli), r, kReadOps / 6 + 1);
+            for (auto& t : pool) t.join();
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            double rate = n * (kReadOps / 6 + 1) * 6 / secs;
+            if (n == 1) base = rate;
+            std::cout << "read scaling: " << n << " thread(s) " << static_cast<long>(rate) << " ops/s (x"
+                      << (base > 0 ? rate / base : 0) << ")\n";
+        }
+    }
+    fs::remove_all(dir, ec);
+    std::cout << (status == 0 ? "Stress test passed\n" : "Stress test FAILED\n");
+    return status;
+}
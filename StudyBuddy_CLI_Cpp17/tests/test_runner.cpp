@@ -7,6 +7,14 @@
 #include <optional>
 #include <sstream>
 #include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <array>
+#include <thread>
+#include <random>
+#include <regex>
+#include <map>
 
 // Project headers
 #include "storage.h"
@@ -16,6 +24,13 @@
 #include "services_match.h"
 #include "services_session.h"
 #include "validation.h"
+#include "csv.h"
+#include "thread_pool.h"
+#include "cli.h"
+#include "server.h"
+#include "trace.h"
+#include "command_table.h"
+#include "file_io.h"
 
 namespace fs = std::filesystem;
 
@@ -46,12 +61,15 @@ static void reset_data_dir(const std::string& dir) {
     std::ofstream(dir + "/availability.csv").close();
     std::ofstream(dir + "/sessions.csv").close();
     std::ofstream(dir + "/session_participants.csv").close();
+    std::ofstream(dir + "/journal.log").close();
 }
 
-static TestContext make_ctx(const std::string& dir) {
+// Fsync by default so every write is on disk before the call returns and the
+// tests can reopen the data directory right away.
+static TestContext make_ctx(const std::string& dir, Durability mode = Durability::Fsync) {
     TestContext ctx;
     ctx.dataDir = dir;
-    ctx.store   = std::make_unique<Storage>(dir);
+    ctx.store   = std::make_unique<Storage>(dir, mode);
     ctx.profile = std::make_unique<ProfileService>(*ctx.store);
     ctx.course  = std::make_unique<CourseService>(*ctx.store);
     ctx.avail   = std::make_unique<AvailabilityService>(*ctx.store);
@@ -81,6 +99,55 @@ static void write_csv(const std::string& path, const std::vector<TestResult>& re
     }
 }
 
+// The students.csv loader as it was before mapping and chunking: getline plus the
+// allocating csv::parse_line. Later rows win, as in Storage; `warnings` gets the text
+// Storage prints for the same lines.
+static std::map<int, Student> read_students_sequential(const std::string& path, std::string& warnings) {
+    std::map<int, Student> out;
+    std::ifstream in(path);
+    std::string line;
+    int ln = 0;
+    while (std::getline(in, line)) {
+        ++ln;
+        auto warn = [&](const char* what) { warnings += "Warning: " + std::string(what) + " " + std::to_string(ln) + " in students.csv\n"; };
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        auto f = csv::parse_line(line);
+        if (f.empty()) { warn("malformed line"); continue; }
+        if (f.size() < 3) { warn("short line"); continue; }
+        Student st;
+        try {
+            std::size_t used = 0;
+            st.id = std::stoi(f[0], &used);
+            if (used != f[0].size()) throw std::invalid_argument(f[0]);
+            if (f.size() >= 4 && !f[3].empty()) st.pass_hash = std::stoull(f[3]);
+        } catch (const std::exception&) { warn("bad data at line"); continue; }
+        st.name = f[1];
+        st.email = f[2];
+        out[st.id] = st;
+    }
+    return out;
+}
+
+static bool same_students(const Storage& store, const std::map<int, Student>& expected) {
+    if (store.students.size() != expected.size()) return false;
+    for (const auto& kv : expected) {
+        auto it = store.students.find(kv.first);
+        if (it == store.students.end() || it->second.name != kv.second.name || it->second.email != kv.second.email
+            || it->second.pass_hash != kv.second.pass_hash) return false;
+    }
+    return true;
+}
+
+// Load `dir` with Storage, returning what it printed to std::cerr.
+static std::string load_capturing_warnings(const std::string& dir, std::unique_ptr<Storage>& out) {
+    std::ostringstream captured;
+    auto* old = std::cerr.rdbuf(captured.rdbuf());
+    out = std::make_unique<Storage>(dir);
+    std::cerr.rdbuf(old);
+    return captured.str();
+}
+
 int main() {
     std::vector<TestResult> results;
     const std::string DIR = "test_data";
@@ -98,6 +165,13 @@ int main() {
         bool ok = !id.has_value();
         results.push_back({"T02","Duplicate email rejected", ok, ok ? "" : "Duplicate allowed"});
     }
+    { // T32 Error-code overloads report instead of printing
+        std::string e1, e2, e3;
+        bool ok = !ctx.profile->create_profile("Dup","avery@clemson.edu", std::nullopt, e1) && e1 == "DUP_EMAIL"
+               && !ctx.profile->create_profile("Bad","not-an-email", std::nullopt, e2) && e2 == "BAD_EMAIL"
+               && !ctx.profile->edit_profile_name(999, "Ghost", e3) && e3 == "NO_STUDENT";
+        results.push_back({"T32","Profile errors returned as codes", ok, ok ? "" : (e1+","+e2+","+e3)});
+    }
 
     // ---- Courses ----
     { // T03 Add course
@@ -166,6 +240,15 @@ int main() {
         ctx.avail->add_availability(userB, 2, 15, 17, e);
     }
 
+    { // T22 Overlap hours come out as per-day runs
+        std::string err;
+        auto matches = ctx.match->suggest_matches(1, "CPSC 2120", err);
+        bool ok = matches.size() == 1 && matches[0].classmate_id == userB
+               && matches[0].overlaps.size() == 1 && matches[0].overlaps[0].first == 2
+               && matches[0].overlaps[0].second == std::vector<int>{15, 16};
+        results.push_back({"T22","Suggest matches reports overlapping hours", ok, ok ? "" : "Unexpected overlap hours"});
+    }
+
     // ---- Scheduling ----
     int sessId = -1;
     { // T11 Valid schedule
@@ -209,6 +292,14 @@ int main() {
         results.push_back({"T14","Confirm by non-participant rejected", ok, ok ? "" : err});
     }
 
+    { // T29 Common slots: shared availability minus confirmed sessions
+        std::string err, err2;
+        auto slots = ctx.session->find_common_slots(1, "CPSC 2120", std::vector<int>{userB}, err);
+        bool ok = err.empty() && slots.size() == 1 && slots[0].day == 2 && slots[0].start == 16
+               && slots[0].window_start == 16 && slots[0].window_end == 17
+               && ctx.session->find_common_slots(1, "CPSC 2120", std::vector<int>{userB, 999}, err2).empty() && err2 == "INV_ID";
+        results.push_back({"T29","Find common slots for a group", ok, ok ? "" : ("err="+err+" err2="+err2)});
+    }
     { // T19 Cancel
         std::string err;
         bool ok = ctx.session->cancel_session(1, sessId, "Conflict", err);
@@ -216,6 +307,972 @@ int main() {
         results.push_back({"T19","Cancel session sets CANCELLED", ok && cancelled, ok ? "" : err});
     }
 
+    { // T23 Per-student indexes follow removals
+        std::string err;
+        ctx.course->add_course(userC, "CPSC 2120", err);
+        bool added = ctx.store->enrollments_of(userC).size() == 1;
+        bool removed = ctx.course->remove_course(userC, "CPSC 2120", err);
+        auto course_id = ctx.store->courses.find("CPSC 2120");
+        const auto& members = ctx.store->students_in(course_id ? *course_id : -1);
+        long inCourse = std::count(members.begin(), members.end(), userC);
+        bool ok = course_id && ctx.store->courses.code(*course_id) == "CPSC 2120" && added && removed && ctx.store->enrollments_of(userC).empty() && inCourse == 0
+               && ctx.store->sessions_of(userB).size() == 1;
+        results.push_back({"T23","Indexes stay in sync after add/remove", ok, ok ? "" : ("err="+err)});
+    }
+
+    { // T31 Busy hours follow confirm and cancel, and survive a reload
+        std::string err;
+        bool sched = ctx.session->schedule_session(1, "CPSC 2120", 2, 16, std::vector<int>{userB}, err);
+        int sid = ctx.store->nextSessionId - 1;
+        bool before = ctx.session->has_conflict(userB, 2, 16);
+        bool confirmed = sched && ctx.session->confirm_session(1, sid, err) && ctx.session->confirm_session(userB, sid, err);
+        bool busy = ctx.session->has_conflict(1, 2, 16) && ctx.session->has_conflict(userB, 2, 16);
+        Storage reloaded(DIR);
+        bool persisted = reloaded.busy_mask(userB).test(week_bit(2, 16)) && reloaded.busy_mask(userB).count() == 1;
+        bool cancelled = ctx.session->cancel_session(userB, sid, "moved", err);
+        bool freed = !ctx.session->has_conflict(1, 2, 16) && ctx.store->busy_mask(userB).none();
+        bool ok = !before && confirmed && busy && persisted && cancelled && freed;
+        std::ostringstream ss; ss << "err=" << err << " busy=" << busy << " persisted=" << persisted << " freed=" << freed;
+        results.push_back({"T31","Conflict checks use per-student busy hours", ok, ok ? "" : ss.str()});
+    }
+    { // T33 Transactions: one journal append on commit, undo on rollback; compaction skips clean tables
+        std::string err;
+        ctx.store->compact();
+        auto records = ctx.store->journalRecords;
+        bool committed;
+        {
+            Storage::Transaction txn(*ctx.store);
+            ctx.avail->add_availability(userC, 4, 9, 11, err);
+            ctx.avail->add_availability(userC, 4, 10, 13, err);
+            bool buffered = ctx.store->journalRecords == records && fs::file_size(DIR + "/journal.log") == 0;
+            committed = buffered && txn.commit() && ctx.store->journalRecords == records + 3;
+        }
+        {
+            Storage::Transaction txn(*ctx.store);
+            ctx.course->add_course(userC, "MATH 1060", err);
+        }
+        std::size_t courseCount = ctx.store->courses.size();
+        bool rejected = !ctx.course->add_course(userC, "NOT A CODE", err) && !ctx.course->add_course(1, "CPSC 2120", err)
+                     && err == "DUP_COURSE" && ctx.store->courses.size() == courseCount;
+        bool rolledBack = ctx.course->list_courses(userC).empty() && !ctx.store->courses.find("MATH 1060").has_value()
+                       && ctx.store->availability_of(userC).size() == 1 && rejected;
+        auto old = fs::last_write_time(DIR + "/students.csv") - std::chrono::hours(1);
+        fs::last_write_time(DIR + "/students.csv", old);
+        ctx.store->compact();
+        bool skipped = fs::last_write_time(DIR + "/students.csv") == old;
+        Storage reloaded(DIR);
+        bool kept = reloaded.availability_of(userC).size() == 1 && reloaded.availability_of(userC)[0].end == 13;
+        bool ok = committed && rolledBack && skipped && kept;
+        std::ostringstream ss; ss << "committed=" << committed << " rolledBack=" << rolledBack << " skipped=" << skipped << " kept=" << kept;
+        results.push_back({"T33","Storage transactions coalesce journal writes", ok, ok ? "" : ss.str()});
+    }
+    { // T24 string_view CSV parser handles quotes and escapes
+        std::vector<std::string_view> f;
+        std::string scratch;
+        int n = 0;
+        bool ok = csv::parse_line(std::string_view("12,\"Lee, J\",\"say \"\"hi\"\"\",,x"), f, scratch)
+               && f.size() == 5 && f[1] == "Lee, J" && f[2] == "say \"hi\"" && f[3].empty() && f[4] == "x"
+               && csv::parse_int(f[0], n) && n == 12 && !csv::parse_int(f[4], n)
+               && !csv::parse_line(std::string_view("1,\"open"), f, scratch);
+        results.push_back({"T24","CSV field views and integer parsing", ok, ok ? "" : "Unexpected fields"});
+    }
+
+    // ---- Persistence ----
+    { // T20 Journal replay restores in-memory state
+        Storage reloaded(DIR);
+        bool ok = reloaded.students.size() == ctx.store->students.size()
+               && reloaded.enrollments_of(userB).size() == ctx.store->enrollments_of(userB).size()
+               && reloaded.availability_of(1).size() == ctx.store->availability_of(1).size()
+               && reloaded.participants_of(sessId).size() == ctx.store->participants_of(sessId).size()
+               && reloaded.sessions.count(sessId)
+               && reloaded.sessions[sessId].status == SessionStatus::CANCELLED
+               && reloaded.nextStudentId == ctx.store->nextStudentId;
+        results.push_back({"T20","Journal replay restores state", ok, ok ? "" : "Reloaded state differs"});
+    }
+    { // T21 Compaction folds the journal into the CSVs
+        ctx.store->compact();
+        Storage reloaded(DIR);
+        bool ok = fs::file_size(DIR + "/journal.log") == 0 && reloaded.journalRecords == 0
+               && reloaded.students.size() == ctx.store->students.size()
+               && reloaded.availability_of(userB).size() == ctx.store->availability_of(userB).size()
+               && reloaded.sessions.size() == ctx.store->sessions.size();
+        results.push_back({"T21","Compaction empties journal and keeps state", ok, ok ? "" : "State lost on compaction"});
+    }
+
+    { // T25 Binary snapshot round-trip (startup path and import), corrupt file rejected
+        const std::string snap = DIR + "/snapshot.bin";
+        bool wrote = ctx.store->write_snapshot(snap);
+        Storage fromSnap(DIR);
+        bool same = fromSnap.students.size() == ctx.store->students.size()
+                 && fromSnap.students[1].email == ctx.store->students[1].email
+                 && fromSnap.availability_of(1).size() == ctx.store->availability_of(1).size()
+                 && fromSnap.sessions[sessId].cancel_reason == ctx.store->sessions[sessId].cancel_reason
+                 && fromSnap.participants_of(sessId).size() == ctx.store->participants_of(sessId).size()
+                 && fromSnap.nextSessionId == ctx.store->nextSessionId;
+        {
+            std::fstream f(snap, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(-1, std::ios::end);
+            f.put('\x7f');
+        }
+        bool rejected = !fromSnap.import_snapshot(snap) && fromSnap.students.size() == ctx.store->students.size();
+        fs::remove(snap);
+        bool ok = wrote && same && rejected;
+        std::ostringstream ss; ss << "wrote="<<wrote<<" same="<<same<<" rejected="<<rejected;
+        results.push_back({"T25","Binary snapshot round-trip", ok, ok ? "" : ss.str()});
+    }
+    { // T34 Background persistence: queued appends land on flush; a failed table write keeps the journal
+        const std::string PDIR = "test_data_persist";
+        reset_data_dir(PDIR);
+        bool flushed, reloaded, kept, healed;
+        {
+            auto pc = make_ctx(PDIR, Durability::Periodic);
+            std::string err;
+            for (int i = 0; i < 50; ++i) pc.profile->create_profile("P" + std::to_string(i), "p" + std::to_string(i) + "@clemson.edu", std::nullopt, err);
+            flushed = pc.store->flush() && pc.store->journalRecords == 50;
+            reloaded = Storage(PDIR).students.size() == 50;
+            fs::create_directory(PDIR + "/students.csv.tmp"); // the students.csv rewrite cannot succeed
+            pc.store->compact();
+            kept = !pc.store->flush() && fs::file_size(PDIR + "/journal.log") > 0;
+            fs::remove(PDIR + "/students.csv.tmp");
+            // No new records, but the next compaction retries the failed table and then truncates.
+            healed = pc.store->compact() && pc.store->flush() && fs::file_size(PDIR + "/journal.log") == 0;
+        }
+        bool recovered = Storage(PDIR).students.size() == 50;
+        // Fsync mode sees the failure in compact() itself, keeps the journal and retries the table next time.
+        bool refused, retried;
+        {
+            auto fc = make_ctx(PDIR);
+            fs::create_directory(PDIR + "/students.csv.tmp");
+            std::string err;
+            fc.profile->create_profile("Late", "late@clemson.edu", std::nullopt, err);
+            refused = !fc.store->compact() && fs::file_size(PDIR + "/journal.log") > 0;
+            fs::remove(PDIR + "/students.csv.tmp");
+            retried = fc.store->compact() && fs::file_size(PDIR + "/journal.log") == 0;
+        }
+        bool rewritten = Storage(PDIR).students.size() == 51;
+        fs::remove_all(PDIR);
+        bool ok = flushed && reloaded && kept && healed && recovered && refused && retried && rewritten;
+        std::ostringstream ss; ss << "flushed=" << flushed << " reloaded=" << reloaded << " kept=" << kept << " healed=" << healed << " recovered=" << recovered
+                                  << " refused=" << refused << " retried=" << retried << " rewritten=" << rewritten;
+        results.push_back({"T34","Background persistence flushes and keeps the journal on failure", ok, ok ? "" : ss.str()});
+    }
+    { // T35 Daemon: per-connection logins over one shared Storage, concurrent clients
+        const std::string SDIR = "test_data_server";
+        const std::string sock = SDIR + "/t.sock";
+        reset_data_dir(SDIR);
+        std::atomic<int> served{0};
+        bool logins = false, whoami = false, capped = false;
+        int rc = -1;
+        {
+            CLI cli(SDIR, Durability::Fsync);
+            Server server(cli, sock);
+            std::thread daemon([&]{ rc = server.run(); });
+            ServerConnection a, b;
+            for (int i = 0; i < 100 && !a.open(sock); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            b.open(sock);
+            std::string out, err, outB;
+            bool okA = false, okB = false;
+            logins = a.request("create_profile --name Ana --email ana@clemson.edu", out, err, okA)
+                  && b.request("create_profile --name Ben --email ben@clemson.edu", out, err, okB) && okA && okB;
+            whoami = a.request("whoami", out, err, okA) && out.find("Ana") != std::string::npos
+                  && b.request("whoami", outB, err, okB) && outB.find("Ben") != std::string::npos;
+            std::vector<std::thread> clients;
+            for (int t = 0; t < 4; ++t) {
+                clients.emplace_back([&, t]{
+                    ServerConnection c;
+                    if (!c.open(sock)) return;
+                    std::string o, e;
+                    bool ok = false;
+                    std::string email = "c" + std::to_string(t) + "@clemson.edu";
+                    if (c.request("create_profile --name C --email " + email, o, e, ok) && ok) ++served;
+                    for (int i = 0; i < 50; ++i) {
+                        if (c.request("add_course --code \"CPSC " + std::to_string(1000 + i) + "\"", o, e, ok) && ok) ++served;
+                        if (c.request("list_courses", o, e, ok) && ok) ++served;
+                    }
+                });
+            }
+            for (auto& c : clients) c.join();
+            // A line past the cap gets an error reply and the connection is closed.
+            ServerConnection flood;
+            bool okF = true;
+            capped = flood.open(sock) && flood.request(std::string(64 * 1024, 'x'), out, err, okF)
+                  && !okF && err == "[ERROR] LINE_TOO_LONG\n" && !flood.request("whoami", out, err, okF)
+                  && a.request("whoami", out, err, okA) && okA;
+            server.stop();
+            daemon.join();
+        }
+        Storage reloaded(SDIR);
+        bool persisted = reloaded.students.size() == 6 && reloaded.enrollments_of(3).size() == 50
+                      && reloaded.journalRecords == 0 && !fs::exists(sock);
+        fs::remove_all(SDIR);
+        bool ok = rc == 0 && logins && whoami && served == 4 * 101 && capped && persisted;
+        std::ostringstream ss; ss << "rc=" << rc << " logins=" << logins << " whoami=" << whoami << " served=" << served
+                                  << " capped=" << capped << " persisted=" << persisted;
+        results.push_back({"T35","Daemon serves concurrent clients with their own logins", ok, ok ? "" : ss.str()});
+    }
+    { // T36 Latency histograms: log2 buckets, percentiles, and the stats command
+        LatencyHistogram h;
+        for (int i = 0; i < 90; ++i) h.record(1000);   // bucket 9: [512, 1024) ns
+        for (int i = 0; i < 10; ++i) h.record(300000); // bucket 18: the slow tail
+        auto snap = h.snapshot();
+        bool buckets = snap.count == 100 && snap.buckets[9] == 90 && snap.buckets[18] == 10 && snap.max_ns == 300000;
+        bool pct = snap.percentile_ns(50) == 1023 && snap.percentile_ns(90) == 1023
+                && snap.percentile_ns(99) == 300000 && snap.sum_ns == 90 * 1000 + 10 * 300000;
+        CLI cli(DIR, Durability::Fsync);
+        CLI::Client c;
+        std::ostringstream out, errs;
+        c.out = &out; c.errs = &errs;
+        cli.run_command(c, "help");
+        bool shown = cli.run_command(c, "stats") && out.str().find("cmd.help") != std::string::npos
+                  && out.str().find("storage.parse") != std::string::npos;
+        bool ok = buckets && pct && shown;
+        std::ostringstream ss; ss << "buckets=" << buckets << " pct=" << pct << " shown=" << shown;
+        results.push_back({"T36","Latency histograms and stats command", ok, ok ? "" : ss.str()});
+    }
+    { // T37 Trace export: spans from the caller and pool threads in Chrome trace format
+        const std::string TRACE = DIR + "/trace.json";
+        trace::start();
+        {
+            CLI cli(DIR, Durability::Fsync);
+            CLI::Client c;
+            std::ostringstream out, errs;
+            c.out = &out; c.errs = &errs;
+            cli.run_command(c, "login --email jlee3@clemson.edu");
+            cli.run_command(c, "search_matches --course \"CPSC 2120\"");
+        }
+        trace::stop();
+        bool written = trace::write(TRACE);
+        std::ifstream ifs(TRACE);
+        std::string json((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        bool spans = json.find("\"Storage::load_all\"") != std::string::npos
+                  && json.find("\"search_matches\"") != std::string::npos
+                  && json.find("\"ph\":\"X\"") != std::string::npos
+                  && json.find("\"thread_name\"") != std::string::npos;
+        std::size_t before = json.size();
+        trace::Span after("after stop");
+        bool off = !trace::enabled() && trace::write(TRACE) && fs::file_size(TRACE) == before;
+        fs::remove(TRACE);
+        bool ok = written && spans && off;
+        std::ostringstream ss; ss << "written=" << written << " spans=" << spans << " off=" << off;
+        results.push_back({"T37","Trace export records spans in Chrome trace format", ok, ok ? "" : ss.str()});
+    }
+    { // T38 Command table: perfect-hash lookup, typed flags, quoting, usage errors
+        bool lookup = find_command("frobnicate") == nullptr && find_command("") == nullptr && find_command("list") == nullptr;
+        for (const auto& spec : kCommandTable) lookup = lookup && find_command(spec.name) == &spec;
+        const CommandSpec& sched = *find_command("schedule_session");
+        CommandArgs a;
+        bool typed = parse_command_args(sched, " --invite \"3, 7\" --day 2 --course \"CPSC 2120\" --start 10 --day 4", a)
+                  && a.integer("--day") == 4 && a.integer("--start") == 10 && a.text("--course") == "CPSC 2120"
+                  && a.ids("--invite") == std::vector<int>{3, 7};
+        // Short id lists are views into the CommandArgs; lines past its inline buffers spill
+        // to the heap and still parse.
+        IdSpan invite = a.ids("--invite");
+        typed = typed && invite.begin() >= reinterpret_cast<const int*>(&a)
+                      && invite.end() <= reinterpret_cast<const int*>(&a + 1);
+        std::vector<int> manyIds;
+        std::string many;
+        for (std::size_t i = 0; i < 3 * CommandArgs::kInlineIds; ++i) {
+            manyIds.push_back(static_cast<int>(i + 1));
+            many += (i ? "," : "") + std::to_string(i + 1);
+        }
+        std::string longReason(2 * CommandArgs::kScratchBytes, 'x');
+        const std::string bigLine = "--course \"CPSC 2120\" --day 1 --start 1 --invite 5,6 --invite \"" + many + "\"";
+        const std::string bigReason = "--id 5 --reason \"" + longReason + "\"\"" + longReason + "\"";
+        CommandArgs big, longText;
+        bool limit = parse_command_args(sched, bigLine, big) && big.ids("--invite") == manyIds
+                  && parse_command_args(*find_command("cancel_session"), bigReason, longText)
+                  && longText.text("--reason") == longReason + "\"" + longReason;
+        CommandArgs q;
+        bool quoted = parse_command_args(*find_command("cancel_session"), "--id 5 --reason \"say \"\"hi\"\"\" ", q)
+                   && q.text("--reason") == "say \"hi\"" && !q.has("--nope");
+        CommandArgs b1, b2, b3, b4, b5;
+        bool errors = !parse_command_args(sched, "--course \"CPSC 2120\" --day x --start 1 --invite 2", b1)
+                   && b1.status() == CommandArgs::Status::BadValue && std::string(b1.error_code()) == "BAD_TIME"
+                   && !parse_command_args(sched, "--course CPSC --day 1 --start 1 --invite 2", b2)
+                   && std::string(b2.error_code()) == "BAD_COURSE"
+                   && !parse_command_args(sched, "--course \"CPSC 2120\" --day 1 --start 1", b3)
+                   && b3.status() == CommandArgs::Status::Usage && b3.failed_flag() == "--invite"
+                   && !parse_command_args(*find_command("whoami"), "--verbose", b4)
+                   && b4.status() == CommandArgs::Status::UnknownFlag
+                   && !parse_command_args(*find_command("match_matrix"), "--course \"CPSC 2120\" --out m --format xml", b5)
+                   && b5.status() == CommandArgs::Status::Usage;
+        CLI cli(DIR, Durability::Fsync);
+        CLI::Client c;
+        std::ostringstream out, errs;
+        c.out = &out; c.errs = &errs;
+        bool help = cli.run_command(c, "help") && out.str().find("  schedule_session --course <DEPT NUM> --day <0..6>") != std::string::npos;
+        bool usage = !cli.run_command(c, "login") && errs.str() == "Usage: login --email <str> [--passcode <str>]\n";
+        bool ok = lookup && typed && limit && quoted && errors && help && usage;
+        std::ostringstream ss; ss << "lookup=" << lookup << " typed=" << typed << " limit=" << limit << " quoted=" << quoted
+                                  << " errors=" << errors << " help=" << help << " usage=" << usage;
+        results.push_back({"T38","Command table parses typed flags and generates usage", ok, ok ? "" : ss.str()});
+    }
+    { // T39 Hand-written validators accept exactly what the old regexes accepted
+        const std::regex emailRe(R"(^[^@\s]+@[^@\s]+\.[^@\s]+$)");
+        const std::regex courseRe(R"(^[A-Z]{2,5} [0-9]{3,4}$)");
+        // Boundary characters of every class in the patterns, plus each regex whitespace.
+        const std::string alphabet = std::string("@.AZ[`az09/: \t\n\v\f\r_-") + '\x85' + '\xA0' + '\0';
+        std::mt19937 rng(2024);
+        auto pick = [&](const std::string& from) { return from[rng() % from.size()]; };
+        auto run_of = [&](const std::string& from, std::size_t maxLen) {
+            std::string out(rng() % (maxLen + 1), ' ');
+            for (auto& ch : out) ch = pick(from);
+            return out;
+        };
+        int emailDiffs = 0, courseDiffs = 0, emailsAccepted = 0, coursesAccepted = 0;
+        std::string firstDiff;
+        auto check = [&](const std::string& text) {
+            bool e = is_valid_email(text), c = is_valid_course(text);
+            if (e != std::regex_match(text, emailRe)) { ++emailDiffs; if (firstDiff.empty()) firstDiff = "email:" + text; }
+            if (c != std::regex_match(text, courseRe)) { ++courseDiffs; if (firstDiff.empty()) firstDiff = "course:" + text; }
+            emailsAccepted += e;
+            coursesAccepted += c;
+        };
+        for (int i = 0; i < 20000; ++i) check(run_of(alphabet, 10));
+        // Near-misses of each shape, so both accept and reject paths are covered.
+        auto part = [&](const char* clean, const char* noisy, std::size_t maxLen) { return run_of(rng() % 4 ? clean : noisy, maxLen); };
+        for (int i = 0; i < 20000; ++i) {
+            check(part("ab.", "ab.@ \t", 3) + "@" + part("ab.", "ab.@ \t", 4) + "." + part("ab.", "ab.@ \t", 3));
+            check(part("AZ", "AZ[@a", 6) + (rng() % 8 ? " " : std::string(1, pick(alphabet))) + part("09", "09/:a ", 5));
+        }
+        for (const char* fixed : {"", "@", "a@b.c", "a@.bc", "a@bc.", "@b.c", "a@@b.c", "a@b.c\n", "CPSC 2120",
+                                  "CPSC 2120\n", "CPSC  2120", "cpsc 2120", "CPSC\t2120", "AB 123", "ABCDEF 123"}) {
+            check(fixed);
+        }
+        bool ok = emailDiffs == 0 && courseDiffs == 0 && emailsAccepted > 1000 && coursesAccepted > 1000;
+        std::ostringstream ss; ss << "emailDiffs=" << emailDiffs << " courseDiffs=" << courseDiffs << " accepted="
+                                  << emailsAccepted << "/" << coursesAccepted << " first=" << firstDiff;
+        results.push_back({"T39","Validators match the email and course regexes", ok, ok ? "" : ss.str()});
+    }
+    { // T40 Journal replay: interleaved add/remove records rebuild the same tables and indexes
+        const std::string JDIR = "test_data_replay";
+        reset_data_dir(JDIR);
+        auto jc = make_ctx(JDIR, Durability::Periodic);
+        jc.store->compactThreshold = 1u << 30; // everything stays in the journal
+        const std::vector<std::string> codes = {"CPSC 1010", "CPSC 2120", "MATH 1060", "ENGL 1030", "PHYS 1220"};
+        std::vector<int> ids;
+        std::string err;
+        for (int i = 0; i < 40; ++i) ids.push_back(jc.profile->create_profile("R" + std::to_string(i), "r" + std::to_string(i) + "@clemson.edu", std::nullopt).value_or(-1));
+        std::mt19937 rng(40);
+        for (int round = 0; round < 3000; ++round) {
+            int id = ids[rng() % ids.size()];
+            const std::string& code = codes[rng() % codes.size()];
+            int day = static_cast<int>(rng() % 7), start = 8 + static_cast<int>(rng() % 4);
+            switch (rng() % 4) {
+            case 0: jc.course->add_course(id, code, err); break;
+            case 1: jc.course->remove_course(id, code, err); break;
+            case 2: jc.avail->add_availability(id, day, start, start + 2, err); break;
+            case 3: jc.avail->remove_availability_exact(id, day, start, start + 2, err); break;
+            }
+        }
+        bool flushed = jc.store->flush() && jc.store->journalRecords > 1000;
+        Storage replayed(JDIR);
+        bool same = flushed;
+        for (int id : ids) {
+            auto courses_of = [](const Storage& st, int sid) {
+                std::vector<std::string> out;
+                for (const auto& e : st.enrollments_of(sid)) out.push_back(st.courses.code(e.course_id));
+                std::sort(out.begin(), out.end());
+                return out;
+            };
+            auto slots_of = [](const Storage& st, int sid) {
+                std::vector<std::array<int,3>> out;
+                for (const auto& a : st.availability_of(sid)) out.push_back({a.day, a.start, a.end});
+                std::sort(out.begin(), out.end());
+                return out;
+            };
+            same = same && courses_of(*jc.store, id) == courses_of(replayed, id) && slots_of(*jc.store, id) == slots_of(replayed, id)
+                && jc.store->availability_mask(id) == replayed.availability_mask(id);
+        }
+        for (const auto& code : codes) {
+            auto members = [&](const Storage& st) {
+                auto cid = st.courses.find(code);
+                std::vector<int> out;
+                if (cid) out = st.students_in(*cid);
+                std::sort(out.begin(), out.end());
+                return out;
+            };
+            same = same && members(*jc.store) == members(replayed);
+        }
+        jc.store.reset();
+        fs::remove_all(JDIR);
+        results.push_back({"T40","Journal replay of interleaved adds and removes matches the live tables", same,
+                           same ? "" : (flushed ? "tables differ after replay" : "journal not flushed")});
+    }
+    { // T41 Mapped loading: MappedFile sees the bytes ifstream reads, and the scan loads what getline did
+        const std::string MDIR = "test_data_mapped";
+        reset_data_dir(MDIR);
+        auto read_all = [](const std::string& path) {
+            std::ifstream in(path, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        };
+        std::string big(3 * (1 << 20) + 17, 'x');
+        for (std::size_t i = 0; i < big.size(); i += 61) big[i] = '\n';
+        const std::vector<std::pair<std::string, std::string>> files = {
+            {"empty", ""}, {"no_newline", "1,a,b"}, {"crlf", "1,a,b\r\n2,c,d\r\n"},
+            {"nul", std::string("a\0b\n", 4)}, {"big", big},
+        };
+        bool bytes = MappedFile(MDIR + "/missing").view().empty();
+        for (const auto& f : files) {
+            const std::string path = MDIR + "/" + f.first;
+            { std::ofstream(path, std::ios::binary) << f.second; }
+            MappedFile mapped(path);
+            MappedFile moved(std::move(mapped));
+            bytes = bytes && moved.ok() && moved.view() == read_all(path) && moved.view() == f.second && mapped.view().empty();
+        }
+        {
+            std::ofstream out(MDIR + "/students.csv", std::ios::binary);
+            out << "1,Avery Tiger,avery@clemson.edu,\n"
+                << "2,\"Lee, Jordan\",jlee3@clemson.edu,12345\r\n"
+                << "\n"
+                << "3,\"Casey \"\"CJ\"\" Jones\",casey@clemson.edu,\n"
+                << "4,\"unclosed,x@clemson.edu,\n"
+                << "5,short\n"
+                << "x6,Bad Id,bad@clemson.edu,\n"
+                << "7,Bad Hash,hash@clemson.edu,notanumber\n"
+                << "\r\n"
+                << "1,Avery Renamed,avery2@clemson.edu,99\n"
+                << "8,Last,last@clemson.edu,";
+        }
+        std::string expectedWarnings;
+        auto expected = read_students_sequential(MDIR + "/students.csv", expectedWarnings);
+        std::unique_ptr<Storage> loaded;
+        std::string warnings = load_capturing_warnings(MDIR, loaded);
+        bool rows = same_students(*loaded, expected) && expected.size() == 4 && loaded->students.at(1).name == "Avery Renamed"
+                 && loaded->students.at(3).name == "Casey \"CJ\" Jones" && loaded->students.at(2).pass_hash == std::size_t{12345};
+        bool warned = warnings == expectedWarnings;
+        loaded.reset();
+        fs::remove_all(MDIR);
+        bool ok = bytes && rows && warned;
+        std::ostringstream ss; ss << "bytes=" << bytes << " rows=" << rows << " warned=" << warned << " got=" << warnings;
+        results.push_back({"T41","Mapped CSV scan loads the same rows as the getline loader", ok, ok ? "" : ss.str()});
+    }
+    { // T42 Parallel loading: a table cut into several chunks loads like the sequential scan
+        const std::string LDIR = "test_data_chunks";
+        reset_data_dir(LDIR);
+        std::size_t enrolled = 0;
+        {
+            std::ofstream stu(LDIR + "/students.csv", std::ios::binary), enr(LDIR + "/enrollments.csv", std::ios::binary);
+            const std::string pad(24, 'n');
+            for (int i = 1; i <= 80000; ++i) {
+                if (i % 997 == 0) stu << i << ",\"unclosed " << pad << ",u" << i << "@clemson.edu,\n";
+                else if (i % 1009 == 0) stu << "id" << i << ",Bad," << "b" << i << "@clemson.edu,\n";
+                else if (i % 101 == 0) stu << "\n";
+                else stu << i << ",\"Student, " << pad << i << "\",s" << i << "@clemson.edu," << (i % 3 ? std::to_string(i * 7) : "")
+                         << (i % 13 ? "\n" : "\r\n");
+                enr << i << ",CPSC " << (1000 + i % 50) << "\n";
+                ++enrolled;
+            }
+        }
+        bool split = fs::file_size(LDIR + "/students.csv") > 3u * (1u << 20);
+        std::string expectedWarnings;
+        auto expected = read_students_sequential(LDIR + "/students.csv", expectedWarnings);
+        std::unique_ptr<Storage> loaded;
+        std::string warnings = load_capturing_warnings(LDIR, loaded);
+        bool rows = same_students(*loaded, expected) && expected.size() > 78000;
+        bool warned = warnings == expectedWarnings && !warnings.empty();
+        std::size_t members = 0;
+        for (int c = 0; c < static_cast<int>(loaded->courses.size()); ++c) members += loaded->students_in(c).size();
+        bool courses = loaded->courses.size() == 50 && members == enrolled;
+        loaded.reset();
+        fs::remove_all(LDIR);
+        bool ok = split && rows && warned && courses;
+        std::ostringstream ss; ss << "split=" << split << " rows=" << rows << " warned=" << warned << " courses=" << courses;
+        results.push_back({"T42","Chunked parallel load matches the sequential scan", ok, ok ? "" : ss.str()});
+    }
+    { // T43 Interned course ids: dense dictionary, and codes survive journal and CSV reloads
+        CourseDictionary dict;
+        bool interned = dict.intern("CPSC 2120") == 0 && dict.intern("MATH 1060") == 1 && dict.intern("CPSC 2120") == 0
+                     && dict.size() == 2 && dict.code(1) == "MATH 1060" && dict.find("MATH 1060") == 1
+                     && !dict.find("ENGL 1030") && dict.size() == 2;
+        dict.clear();
+        interned = interned && dict.size() == 0 && !dict.find("CPSC 2120") && dict.intern("ENGL 1030") == 0;
+
+        const std::string IDIR = "test_data_courses";
+        reset_data_dir(IDIR);
+        const std::vector<std::string> codes = {"CPSC 1010", "CPSC 2120", "CPSC 3220", "MATH 1060", "MATH 2060",
+                                                "ENGL 1030", "PHYS 1220", "CHEM 1010", "HIST 1720", "ECE 2010"};
+        // What the string-keyed tables held before interning: codes per student and per session.
+        std::map<int, std::vector<std::string>> byStudent;
+        std::map<int, std::string> bySession;
+        std::vector<int> ids;
+        {
+            auto ic = make_ctx(IDIR);
+            std::string err;
+            std::mt19937 rng(43);
+            for (int i = 0; i < 12; ++i) {
+                int id = ic.profile->create_profile("C" + std::to_string(i), "c" + std::to_string(i) + "@clemson.edu", std::nullopt).value_or(-1);
+                ids.push_back(id);
+                ic.avail->add_availability(id, 2, 9, 17, err);
+                for (const auto& code : codes) {
+                    if (rng() % 2 && ic.course->add_course(id, code, err)) byStudent[id].push_back(code);
+                }
+                if (rng() % 3 == 0 && !byStudent[id].empty()) {
+                    std::string dropped = byStudent[id].front();
+                    if (ic.course->remove_course(id, dropped, err)) byStudent[id].erase(byStudent[id].begin());
+                }
+            }
+            for (int i = 0; i + 1 < static_cast<int>(ids.size()); ++i) {
+                for (const auto& code : byStudent[ids[i]]) {
+                    const auto& theirs = byStudent[ids[i + 1]];
+                    if (std::find(theirs.begin(), theirs.end(), code) == theirs.end()) continue;
+                    int before = ic.store->nextSessionId;
+                    if (ic.session->schedule_session(ids[i], code, 2, 9 + i % 8, std::vector<int>{ids[i + 1]}, err)) bySession[before] = code;
+                    break;
+                }
+            }
+        }
+        auto matches = [&](const Storage& st) {
+            bool same = st.sessions.size() == bySession.size();
+            for (int id : ids) {
+                std::vector<std::string> have;
+                for (const auto& e : st.enrollments_of(id)) {
+                    same = same && e.course_id >= 0 && e.course_id < static_cast<int>(st.courses.size());
+                    have.push_back(st.courses.code(e.course_id));
+                }
+                auto want = byStudent[id];
+                std::sort(have.begin(), have.end());
+                std::sort(want.begin(), want.end());
+                same = same && have == want;
+            }
+            for (const auto& kv : bySession) {
+                auto it = st.sessions.find(kv.first);
+                same = same && it != st.sessions.end() && st.courses.code(it->second.course_id) == kv.second;
+            }
+            return same;
+        };
+        bool fromJournal, fromCsv;
+        {
+            Storage replayed(IDIR);
+            fromJournal = matches(replayed) && replayed.journalRecords > 0;
+            fromCsv = replayed.compact();
+        }
+        {
+            Storage reloaded(IDIR);
+            fromCsv = fromCsv && reloaded.journalRecords == 0 && matches(reloaded);
+        }
+        fs::remove_all(IDIR);
+        bool ok = interned && fromJournal && fromCsv && bySession.size() >= 3;
+        std::ostringstream ss; ss << "interned=" << interned << " journal=" << fromJournal << " csv=" << fromCsv << " sessions=" << bySession.size();
+        results.push_back({"T43","Course ids round-trip to the same codes through journal and CSV", ok, ok ? "" : ss.str()});
+    }
+    { // T44 Matrix exports stay inside <data dir>/exports and never touch Storage's files
+        const std::string XDIR = "test_data_exports";
+        reset_data_dir(XDIR);
+        bool accepted, rejected, links, cli;
+        {
+            auto xc = make_ctx(XDIR);
+            std::string err;
+            int id = xc.profile->create_profile("Exporter", "export@clemson.edu", std::nullopt).value_or(-1);
+            xc.course->add_course(id, "CPSC 2120", err);
+            auto plain = xc.match->export_path("m.csv", err);
+            auto nested = xc.match->export_path("sub/m.bin", err);
+            accepted = err.empty() && plain && *plain == fs::path(XDIR) / "exports" / "m.csv"
+                    && nested && fs::is_directory(fs::path(XDIR) / "exports" / "sub");
+            rejected = true;
+            for (const char* name : {"", "/tmp/m.csv", "../journal.log", "sub/../../students.csv", "sub/", ".", "./m.csv"}) {
+                err.clear();
+                rejected = rejected && !xc.match->export_path(name, err) && err == "BAD_PATH";
+            }
+            // Symlinks: out of the directory, onto the journal, and the directory itself aliasing the data dir.
+            const fs::path exports = fs::path(XDIR) / "exports";
+            fs::create_directory_symlink("..", exports / "up");
+            fs::create_symlink("../journal.log", exports / "j.csv");
+            err.clear();
+            links = !xc.match->export_path("up/students.csv", err) && err == "BAD_PATH";
+            err.clear();
+            links = links && !xc.match->export_path("j.csv", err) && err == "BAD_PATH";
+            fs::remove_all(exports);
+            fs::create_directory_symlink(".", exports);
+            err.clear();
+            links = links && !xc.match->export_path("students.csv", err) && err == "BAD_PATH" && xc.store->owns_file(exports / "journal.log.tmp");
+            fs::remove(exports);
+        }
+        {
+            CLI app(XDIR, Durability::Fsync);
+            CLI::Client c;
+            std::ostringstream out, errs;
+            c.out = &out; c.errs = &errs;
+            app.run_command(c, "login --email export@clemson.edu");
+            cli = !app.run_command(c, "match_matrix --course \"CPSC 2120\" --out ../escape.csv") && errs.str() == "[ERROR] BAD_PATH\n"
+               && !fs::exists(XDIR + "/../escape.csv")
+               && app.run_command(c, "match_matrix --course \"CPSC 2120\" --out cpsc.csv") && fs::exists(XDIR + "/exports/cpsc.csv");
+        }
+        fs::remove_all(XDIR);
+        bool exclusive = !CLI::is_read_command("match_matrix") && CLI::is_read_command("search_matches");
+        bool ok = accepted && rejected && links && cli && exclusive;
+        std::ostringstream ss; ss << "exclusive=" << exclusive << " accepted=" << accepted << " rejected=" << rejected << " links=" << links << " cli=" << cli;
+        results.push_back({"T44","match_matrix exports are confined to the export directory", ok, ok ? "" : ss.str()});
+    }
+    { // T45 Every mutation commits through a Transaction: a failed journal write is IO_WRITE and changes nothing
+        const std::string WDIR = "test_data_iofail";
+        reset_data_dir(WDIR);
+        int a = -1, b = -1, sid = -1;
+        {
+            auto wc = make_ctx(WDIR);
+            std::string err;
+            a = wc.profile->create_profile("Writer A", "wa@clemson.edu", std::nullopt).value_or(-1);
+            b = wc.profile->create_profile("Writer B", "wb@clemson.edu", std::nullopt).value_or(-1);
+            for (int id : {a, b}) {
+                wc.course->add_course(id, "CPSC 2120", err);
+                wc.avail->add_availability(id, 1, 9, 12, err);
+            }
+            wc.course->add_course(b, "ENGL 1030", err);
+            sid = wc.store->nextSessionId;
+            wc.session->schedule_session(a, "CPSC 2120", 1, 10, std::vector<int>{b}, err);
+            wc.store->compact();
+        }
+        // Every journal append now fails (ENOSPC); the tables on disk are intact.
+        bool haveFull = fs::exists("/dev/full");
+        if (haveFull) {
+            fs::remove(WDIR + "/journal.log");
+            fs::create_symlink("/dev/full", WDIR + "/journal.log");
+        }
+        bool refused = haveFull;
+        if (haveFull) {
+            auto wc = make_ctx(WDIR);
+            std::string err, msg;
+            auto failed = [&](bool done) { bool f = !done && err == "IO_WRITE"; err.clear(); return f; };
+            refused = failed(wc.profile->create_profile("Writer C", "wc@clemson.edu", std::nullopt, err).has_value())
+                   && failed(wc.profile->edit_profile_name(a, "Renamed", err))
+                   && failed(wc.profile->edit_profile_email(a, "renamed@clemson.edu", err))
+                   && failed(wc.course->add_course(a, "MATH 1060", err))
+                   && failed(wc.course->remove_course(b, "ENGL 1030", err))
+                   && failed(wc.session->cancel_session(a, sid, "busy", err))
+                   && !wc.avail->remove_availability_exact(a, 1, 9, 12, msg) && msg == "IO_WRITE";
+            const auto& st = *wc.store;
+            refused = refused && st.students.size() == 2 && !st.studentsByEmail.count("wc@clemson.edu")
+                   && st.students.at(a).name == "Writer A" && st.students.at(a).email == "wa@clemson.edu"
+                   && st.studentsByEmail.count("wa@clemson.edu") && !st.studentsByEmail.count("renamed@clemson.edu")
+                   && !wc.course->enrolled(a, "MATH 1060") && !st.courses.find("MATH 1060") && st.courses.size() == 2
+                   && wc.course->enrolled(b, "ENGL 1030") && st.sessions.at(sid).status == SessionStatus::PROPOSED
+                   && st.availability_of(a).size() == 1 && st.availability_mask(a).count() == 3 && st.nextStudentId == 3;
+        }
+        fs::remove_all(WDIR);
+        results.push_back({"T45","Failed journal writes leave every mutation undone", refused,
+                           refused ? "" : (haveFull ? "a mutation survived a failed commit" : "no /dev/full")});
+    }
+    { // T46 Rollback replays the undo log in memory (no reload), and async modes report failures once the journal fails
+        const std::string UDIR = "test_data_undo";
+        reset_data_dir(UDIR);
+        int a = -1, b = -1, sid = -1;
+        bool nested;
+        {
+            auto uc = make_ctx(UDIR);
+            std::string err;
+            a = uc.profile->create_profile("Undo A", "ua@clemson.edu", std::nullopt).value_or(-1);
+            b = uc.profile->create_profile("Undo B", "ub@clemson.edu", std::nullopt).value_or(-1);
+            for (int id : {a, b}) {
+                uc.course->add_course(id, "CPSC 2120", err);
+                uc.avail->add_availability(id, 1, 9, 12, err);
+            }
+            sid = uc.store->nextSessionId;
+            uc.session->schedule_session(a, "CPSC 2120", 1, 10, std::vector<int>{b}, err);
+            uc.session->confirm_session(a, sid, err);
+            uc.session->confirm_session(b, sid, err);
+            // An outer transaction that ends without commit() undoes the nested, committed ones.
+            {
+                Storage::Transaction outer(*uc.store);
+                uc.profile->create_profile("Undo C", "uc@clemson.edu", std::nullopt, err);
+                uc.course->add_course(a, "MATH 1060", err);
+                uc.course->remove_course(b, "CPSC 2120", err); // SESSIONS_EXIST: no change to undo
+                uc.avail->add_availability(a, 2, 8, 10, err);
+                uc.session->cancel_session(b, sid, "undo me", err);
+            }
+            const auto& st = *uc.store;
+            nested = st.students.size() == 2 && !st.studentsByEmail.count("uc@clemson.edu") && st.nextStudentId == 3
+                  && !uc.course->enrolled(a, "MATH 1060") && st.availability_of(a).size() == 1
+                  && st.availability_mask(a).count() == 3 && st.sessions.at(sid).status == SessionStatus::CONFIRMED
+                  && st.busy_mask(a).test(week_bit(1, 10)) && st.busy_mask(b).test(week_bit(1, 10));
+            uc.store->compact();
+        }
+        bool haveFull = fs::exists("/dev/full");
+        bool undone = haveFull;
+        if (haveFull) {
+            fs::remove(UDIR + "/journal.log");
+            fs::create_symlink("/dev/full", UDIR + "/journal.log");
+            auto uc = make_ctx(UDIR, Durability::Periodic);
+            // A row that appears on disk after loading shows up only if a rollback reloads.
+            { std::ofstream(UDIR + "/students.csv", std::ios::app) << "\n99,Ghost,ghost@clemson.edu,\n"; }
+            std::string err;
+            // Periodic: the first failed append may only be seen by flush(); later ones reach the caller.
+            uc.profile->create_profile("Undo D", "ud@clemson.edu", std::nullopt, err);
+            bool first = !uc.store->flush();
+            err.clear();
+            auto failed = [&](bool done) { bool f = !done && err == "IO_WRITE"; err.clear(); return f; };
+            int nextSession = uc.store->nextSessionId;
+            auto sessionsOfA = uc.store->sessions_of(a);
+            undone = first
+                  && failed(uc.profile->edit_profile_email(a, "moved@clemson.edu", err))
+                  && failed(uc.course->add_course(b, "MATH 1060", err))
+                  && failed(uc.avail->add_availability(a, 2, 8, 10, err))
+                  && failed(uc.session->schedule_session(a, "CPSC 2120", 1, 11, std::vector<int>{b}, err))
+                  && failed(uc.session->cancel_session(a, sid, "busy", err));
+            const auto& st = *uc.store;
+            undone = undone && !st.students.count(99) && st.studentsByEmail.at("ua@clemson.edu") == a
+                  && !st.studentsByEmail.count("moved@clemson.edu") && !uc.course->enrolled(b, "MATH 1060")
+                  && st.availability_of(a).size() == 1 && st.availability_mask(a).count() == 3
+                  && st.nextSessionId == nextSession && st.sessions.size() == 1 && st.sessions_of(a) == sessionsOfA
+                  && st.sessions.at(sid).status == SessionStatus::CONFIRMED && st.busy_mask(a).test(week_bit(1, 10));
+        }
+        fs::remove_all(UDIR);
+        bool ok = nested && undone;
+        std::ostringstream ss; ss << "nested=" << nested << " undone=" << undone << " dev_full=" << haveFull;
+        results.push_back({"T46","Transaction rollback undoes changes in memory", ok, ok ? "" : ss.str()});
+    }
+    { // T47 Trace buffers are capped: spans past the limit are dropped and counted
+        const std::string TRACE = DIR + "/capped.json";
+        std::size_t defaultLimit = trace::span_limit();
+        trace::set_span_limit(10);
+        trace::start();
+        for (int i = 0; i < 25; ++i) trace::Span span("capped span", "test");
+        std::thread other([]{ for (int i = 0; i < 5; ++i) trace::Span span("capped span", "test"); });
+        other.join();
+        trace::stop();
+        bool counted = trace::dropped() == 20;
+        bool written = trace::write(TRACE);
+        std::ifstream ifs(TRACE);
+        std::string json((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        std::size_t kept = 0;
+        for (std::size_t at = json.find("\"ph\":\"X\""); at != std::string::npos; at = json.find("\"ph\":\"X\"", at + 1)) ++kept;
+        bool reported = json.find("\"otherData\":{\"span_limit\":10,\"dropped_spans\":20}") != std::string::npos;
+        // A new start() resets the count and picks up the restored limit.
+        trace::set_span_limit(defaultLimit);
+        trace::start();
+        { trace::Span span("after reset", "test"); }
+        trace::stop();
+        bool reset = trace::dropped() == 0 && trace::span_limit() == defaultLimit;
+        fs::remove(TRACE);
+        bool ok = counted && written && kept == 10 && reported && reset;
+        std::ostringstream ss; ss << "counted=" << counted << " written=" << written << " kept=" << kept << " reported=" << reported << " reset=" << reset;
+        results.push_back({"T47","Trace buffers drop and count spans past the limit", ok, ok ? "" : ss.str()});
+    }
+
+    { // T48 Availability rows with a day or hour outside the week are skipped, not loaded into the masks
+        const std::string ADIR = "test_data_badav";
+        reset_data_dir(ADIR);
+        std::ofstream(ADIR + "/availability.csv") << "1,2,10,12\n1,9,10,12\n1,0,-1,2\n1,3,20,25\n";
+        std::unique_ptr<Storage> loaded;
+        std::string warnings = load_capturing_warnings(ADIR, loaded);
+        std::size_t skipped = 0;
+        for (std::size_t at = warnings.find("bad data at line"); at != std::string::npos; at = warnings.find("bad data at line", at + 1)) ++skipped;
+        WeekMask expected;
+        set_hours(expected, 2, 10, 12);
+        bool ok = skipped == 3 && loaded->availabilityByStudent[1].size() == 1 && loaded->availability_mask(1) == expected;
+        // The mask helpers clamp instead of indexing past the bitset.
+        WeekMask clamped;
+        set_hours(clamped, 9, 0, 4);
+        set_hours(clamped, 0, -3, 30);
+        ok = ok && clamped.count() == kHoursPerDay && !covers_hours(clamped, 0, -1, 2) && covers_hours(clamped, 0, 0, 24)
+                && !covers_hours(clamped, 7, 0, 1);
+        loaded.reset();
+        fs::remove_all(ADIR);
+        results.push_back({"T48","Out-of-range availability rows are skipped on load", ok, ok ? "" : ("skipped=" + std::to_string(skipped) + " warnings=" + warnings)});
+    }
+
+    { // T49 Snapshots whose availability or session day/hour lies outside the week are rejected
+        const std::string SDIR = "test_data_badsnap";
+        reset_data_dir(SDIR);
+        auto sc = make_ctx(SDIR);
+        std::string e;
+        int id = sc.profile->create_profile("Sam", "sam@clemson.edu", std::nullopt, e).value_or(-1);
+        sc.course->add_course(id, "CPSC 2120", e);
+        sc.avail->add_availability(id, 2, 10, 12, e);
+        const std::string badAv = SDIR + "/bad_availability.bin", badSes = SDIR + "/bad_sessions.bin";
+        // The writer does not validate, so bad rows injected in memory reach a file with a good checksum.
+        sc.store->availabilityByStudent[id].push_back(Availability{id, 9, 10, 12});
+        bool wroteAv = sc.store->write_snapshot(badAv);
+        sc.store->availabilityByStudent[id].pop_back();
+        Session bad;
+        bad.id = sc.store->nextSessionId;
+        bad.course_id = 0; bad.day = 2; bad.start = -1; bad.duration = 1; bad.organizer_id = id;
+        sc.store->sessions[bad.id] = bad;
+        bool wroteSes = sc.store->write_snapshot(badSes);
+        sc.store->sessions.erase(bad.id);
+        std::ostringstream captured;
+        auto* old = std::cerr.rdbuf(captured.rdbuf());
+        bool rejected = !sc.store->import_snapshot(badAv) && !sc.store->import_snapshot(badSes);
+        std::cerr.rdbuf(old);
+        std::string why = captured.str();
+        bool kept = sc.store->availability_of(id).size() == 1 && sc.store->sessions.empty();
+        bool ok = wroteAv && wroteSes && rejected && kept && why.find("corrupt availability") != std::string::npos
+               && why.find("corrupt sessions") != std::string::npos;
+        sc.store.reset();
+        fs::remove_all(SDIR);
+        std::ostringstream ss; ss << "wrote=" << wroteAv << wroteSes << " rejected=" << rejected << " kept=" << kept << " why=" << why;
+        results.push_back({"T49","Snapshots with out-of-range days or hours are rejected", ok, ok ? "" : ss.str()});
+    }
+
+    { // T50 Journal records with a day or hour outside the week are skipped on replay
+        const std::string JDIR = "test_data_badjournal";
+        reset_data_dir(JDIR);
+        std::ofstream(JDIR + "/journal.log") << "student,1,Sam,sam@clemson.edu,\n"
+                                             << "avail,1,2,10,12\n" << "avail,1,9,10,12\n" << "avail,1,0,-1,2\n"
+                                             << "session,1,CPSC 2120,2,10,1,1,CONFIRMED,\n"
+                                             << "session,2,CPSC 2120,8,10,1,1,CONFIRMED,\n"
+                                             << "session,3,CPSC 2120,2,-4,1,1,PROPOSED,\n";
+        std::unique_ptr<Storage> loaded;
+        std::string warnings = load_capturing_warnings(JDIR, loaded);
+        std::size_t skipped = 0;
+        for (std::size_t at = warnings.find("bad data at line"); at != std::string::npos; at = warnings.find("bad data at line", at + 1)) ++skipped;
+        bool ok = skipped == 4 && loaded->students.size() == 1 && loaded->availability_of(1).size() == 1
+               && loaded->sessions.size() == 1 && loaded->sessions.count(1) == 1;
+        loaded.reset();
+        fs::remove_all(JDIR);
+        results.push_back({"T50","Out-of-range journal records are skipped on replay", ok, ok ? "" : ("skipped=" + std::to_string(skipped) + " warnings=" + warnings)});
+    }
+
+    { // T52 Journal records written outside a transaction report failed appends; after one, compaction rewrites every table
+        const std::string LDIR = "test_data_lost";
+        reset_data_dir(LDIR);
+        bool haveFull = fs::exists("/dev/full");
+        bool reported = haveFull, healed = haveFull;
+        if (haveFull) {
+            auto add_student = [](Storage& st, int id, const std::string& name) {
+                Student s;
+                s.id = id; s.name = name; s.email = name + "@clemson.edu";
+                st.students[id] = s;
+                st.studentsByEmail[s.email] = id;
+                return st.journal_student(s);
+            };
+            fs::remove(LDIR + "/journal.log");
+            fs::create_symlink("/dev/full", LDIR + "/journal.log");
+            {
+                Storage direct(LDIR, Durability::Fsync);
+                reported = !add_student(direct, 1, "fsync");
+            }
+            Storage pc(LDIR, Durability::Periodic);
+            // The first append may only be queued (its failure then shows at flush()); once the
+            // journal is failing, later appends wait for their write and fail.
+            add_student(pc, 1, "first");
+            reported = reported && !pc.flush() && !add_student(pc, 2, "second");
+            fs::remove(LDIR + "/journal.log");
+            std::ofstream(LDIR + "/journal.log").close();
+            pc.flush(); // consume the second failure
+            auto old = fs::last_write_time(LDIR + "/availability.csv") - std::chrono::hours(1);
+            fs::last_write_time(LDIR + "/availability.csv", old);
+            healed = pc.compact() && pc.flush() && fs::file_size(LDIR + "/journal.log") == 0
+                  && fs::last_write_time(LDIR + "/availability.csv") != old;
+        }
+        bool kept = !haveFull || Storage(LDIR).students.size() == 2;
+        fs::remove_all(LDIR);
+        bool ok = reported && healed && kept;
+        std::ostringstream ss; ss << "reported=" << reported << " healed=" << healed << " kept=" << kept;
+        results.push_back({"T52","Failed journal appends are reported and healed by a full compaction", ok, ok ? "" : ss.str()});
+    }
+
+    { // T26 Ranked top-K matching: score, preferred days, tie-breaks, bound
+        const std::string RDIR = "test_data_rank";
+        reset_data_dir(RDIR);
+        auto rc = make_ctx(RDIR);
+        std::string e;
+        auto seed = [&](const std::string& name, std::vector<std::array<int,3>> slots) {
+            int id = rc.profile->create_profile(name, name + "@clemson.edu", std::nullopt).value_or(-1);
+            rc.course->add_course(id, "CPSC 2120", e);
+            for (const auto& sl : slots) rc.avail->add_availability(id, sl[0], sl[1], sl[2], e);
+            return id;
+        };
+        int me = seed("me", {{1, 10, 14}, {3, 10, 12}});
+        int a = seed("a", {{1, 10, 14}});   // 4h
+        int b = seed("b", {{3, 10, 12}});   // 2h, Wednesday
+        seed("c", {{1, 10, 11}});           // 1h
+        int d = seed("d", {{1, 12, 14}});   // 2h, earlier than b
+        std::string err;
+        const int w = MatchService::kDefaultPreferredWeight;
+        auto plain = rc.match->top_matches(me, "CPSC 2120", 2, {}, w, err);
+        auto pref = rc.match->top_matches(me, "CPSC 2120", 2, std::vector<int>{3}, w, err);
+        auto heavy = rc.match->top_matches(me, "CPSC 2120", 1, std::vector<int>{3}, 3, err);
+        bool ok = err.empty()
+               && plain.size() == 2 && plain[0].classmate_id == a && plain[0].score == 4 && plain[1].classmate_id == d
+               && plain[1].overlaps.size() == 1 && plain[1].overlaps[0].second == std::vector<int>{12, 13}
+               && pref.size() == 2 && pref[0].classmate_id == a && pref[1].classmate_id == b && pref[1].score == 4
+               && heavy.size() == 1 && heavy[0].classmate_id == b && heavy[0].score == 6
+               && rc.match->top_matches(me, "CPSC 2120", 10, {}, w, err).size() == 4
+               && rc.match->top_matches(me, "CPSC 2120", 2, std::vector<int>{9}, w, err).empty() && err == "BAD_DAY"
+               && rc.match->top_matches(me, "CPSC 2120", 2, std::vector<int>{3}, 0, err).empty() && err == "BAD_WEIGHT";
+        results.push_back({"T26","Top-K matches ranked by overlap score", ok, ok ? "" : ("err="+err)});
+
+        // T27 All-pairs matrix agrees with the per-pair overlap and round-trips through CSV
+        err.clear();
+        auto m = rc.match->overlap_matrix("CPSC 2120", err);
+        const std::string out = RDIR + "/matrix.csv";
+        bool wrote = MatchService::write_matrix(m, out, false);
+        std::ifstream in(out);
+        std::string header, row0;
+        std::getline(in, header);
+        std::getline(in, row0);
+        bool mok = err.empty() && wrote && m.size() == 5 && m.student_ids[0] == me
+                && m.at(0, 0) == 6 && m.at(0, 1) == 4 && m.at(1, 0) == 4 && m.at(0, 2) == 2 && m.at(1, 2) == 0
+                && m.at(1, 4) == 2 && m.at(4, 1) == 2
+                && header == "student_id,1,2,3,4,5" && row0 == "1,6,4,2,1,2";
+        results.push_back({"T27","All-pairs overlap matrix for a course", mok, mok ? "" : ("err="+err+" header="+header)});
+
+        // T28 Parallel suggest_matches lists the same classmates in the same order
+        for (int i = 0; i < 40; ++i) seed("p" + std::to_string(i), {{1, 10 + i % 4, 14}, {3, 11, 12}});
+        std::string e1, e2;
+        rc.match->parallelThreshold = 1u << 30;
+        auto seq = rc.match->suggest_matches(me, "CPSC 2120", e1);
+        rc.match->parallelThreshold = 0;
+        auto par = rc.match->suggest_matches(me, "CPSC 2120", e2);
+        bool same = e1.empty() && e2.empty() && seq.size() == 44 && par.size() == seq.size();
+        for (std::size_t i = 0; same && i < seq.size(); ++i) {
+            same = seq[i].classmate_id == par[i].classmate_id && seq[i].overlaps == par[i].overlaps;
+        }
+        ThreadPool pool(3);
+        std::atomic<int> sum{0};
+        std::vector<std::future<std::future<void>>> outer;
+        for (int i = 0; i < 50; ++i) {
+            outer.push_back(pool.submit([&pool, &sum, i]{ return pool.submit([&sum, i]{ sum += i; }); }));
+        }
+        for (auto& o : outer) o.get().get();
+        bool pooled = sum == 50 * 49 / 2;
+        results.push_back({"T28","Parallel matching keeps sequential order", same && pooled,
+                           same && pooled ? "" : (same ? "pool lost tasks" : "order differs")});
+
+        // T30 Auto-scheduler: disjoint groups, each member free at the proposed hour
+        err.clear();
+        auto proposed = rc.session->auto_schedule(me, "CPSC 2120", 4, err);
+        std::unordered_map<int, int> seen;
+        bool aok = err.empty() && !proposed.empty();
+        for (const auto& sess : proposed) {
+            const auto& members = rc.store->participants_of(sess.id);
+            aok = aok && sess.status == SessionStatus::PROPOSED && members.size() >= 2 && members.size() <= 4;
+            for (const auto& p : members) {
+                aok = aok && ++seen[p.student_id] == 1 && p.student_id >= sess.organizer_id
+                    && rc.avail->within_availability(p.student_id, sess.day, sess.start, sess.start + 1)
+                    && !rc.session->has_conflict(p.student_id, sess.day, sess.start);
+            }
+        }
+        aok = aok && proposed.front().day == 1 && proposed.front().start == 13
+            && rc.session->auto_schedule(me, "CPSC 2120", 1, err).empty() && err == "BAD_SIZE";
+        results.push_back({"T30","Auto-schedule proposes disjoint feasible groups", aok, aok ? "" : ("err="+err)});
+
+        auto best = rc.match->top_matches(me, "CPSC 2120", 1, std::vector<int>{3}, 3, err);
+        rc.store.reset();
+
+        // T51 search_matches rejects flags the chosen mode would ignore or contradict
+        CLI rcli(RDIR, Durability::Fsync);
+        CLI::Client rclient;
+        std::ostringstream rout, rerrs;
+        rclient.out = &rout; rclient.errs = &rerrs;
+        rcli.run_command(rclient, "login --email me@clemson.edu");
+        auto rejects = [&](const std::string& line) {
+            rerrs.str("");
+            return !rcli.run_command(rclient, line) && rerrs.str() == "[ERROR] BAD_ARGS\n";
+        };
+        bool flags = rejects("search_matches --course \"CPSC 2120\" --top 2 --sort earliest")
+                  && rejects("search_matches --course \"CPSC 2120\" --prefer 3")
+                  && rejects("search_matches --course \"CPSC 2120\" --sort earliest --prefer 3")
+                  && rejects("search_matches --course \"CPSC 2120\" --top 2 --weight 3");
+        rout.str("");
+        flags = flags && best.size() == 1
+                      && rcli.run_command(rclient, "search_matches --course \"CPSC 2120\" --top 1 --prefer 3 --weight 3")
+                      && rout.str().find("#" + std::to_string(best[0].classmate_id) + " " + best[0].classmate_name
+                                         + " (score " + std::to_string(best[0].score) + ")") == 0;
+        results.push_back({"T51","search_matches rejects conflicting ranking flags", flags, flags ? "" : ("out=" + rout.str() + " errs=" + rerrs.str())});
+        fs::remove_all(RDIR);
+    }
+
     // Output CSV
     write_csv("test_results.csv", results);
 
@@ -0,0 +1,164 @@
+#include "datagen.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// splitmix64: tiny, fast and identical on every platform.
+class Rng {
+public:
+    explicit Rng(std::uint64_t seed): state(seed) {}
+    std::uint64_t next() {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    // Uniform in [0, n).
+    std::size_t below(std::size_t n) { return static_cast<std::size_t>(next() % n); }
+    double unit() { return static_cast<double>(next() >> 11) / static_cast<double>(1ULL << 53); }
+
+private:
+    std::uint64_t state;
+};
+
+// Rank r (0-based) is picked with weight 1 / (r+1)^s.
+class Zipf {
+public:
+    Zipf(std::size_t n, double s) {
+        cdf.reserve(n);
+        double total = 0;
+        for (std::size_t r = 0; r < n; ++r) cdf.push_back(total += 1.0 / std::pow(static_cast<double>(r + 1), s));
+        for (auto& c : cdf) c /= total;
+    }
+    std::size_t sample(Rng& rng) const {
+        auto it = std::lower_bound(cdf.begin(), cdf.end(), rng.unit());
+        return it == cdf.end() ? cdf.size() - 1 : static_cast<std::size_t>(it - cdf.begin());
+    }
+
+private:
+    std::vector<double> cdf;
+};
+
+const std::array<const char*, 12> kDepts = {"CPSC", "MATH", "ENGL", "PHYS", "CHEM", "BIOL",
+                                            "ECE", "ME", "HIST", "PSYC", "ECON", "STAT"};
+const std::array<const char*, 16> kFirst = {"Avery", "Jordan", "Taylor", "Morgan", "Riley", "Casey", "Jamie", "Quinn",
+                                            "Alex", "Sam", "Drew", "Parker", "Reese", "Skyler", "Hayden", "Logan"};
+const std::array<const char*, 16> kLast = {"Tiger", "Smith", "Lee", "Garcia", "Patel", "Nguyen", "Brown", "Davis",
+                                           "Wilson", "Clark", "Lewis", "Young", "Hall", "King", "Wright", "Scott"};
+
+bool write_file(const fs::path& path, const std::string& bytes) {
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    ofs.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    if (!ofs) { std::cerr << "[ERROR] IO_WRITE: cannot write " << path << "\n"; return false; }
+    return true;
+}
+
+} // namespace
+
+bool generate_dataset(const fs::path& dir, const DatasetSpec& spec, DatasetStats& stats) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    fs::remove(dir / "snapshot.bin", ec);
+    Rng rng(spec.seed);
+    stats = DatasetStats{};
+    stats.students = spec.students;
+
+    // Courses: unique codes; rank 0 is the most popular.
+    std::size_t courseCount = std::max<std::size_t>(20, spec.students / 40);
+    std::vector<std::string> courses;
+    courses.reserve(courseCount);
+    std::vector<bool> used(kDepts.size() * 4000, false);
+    while (courses.size() < courseCount) {
+        std::size_t d = rng.below(kDepts.size()), num = 1000 + rng.below(4000);
+        std::size_t key = d * 4000 + (num - 1000);
+        if (used[key]) continue;
+        used[key] = true;
+        courses.push_back(std::string(kDepts[d]) + " " + std::to_string(num));
+    }
+    stats.courses = courseCount;
+    Zipf popularity(courseCount, 1.1);
+    std::vector<std::vector<int>> roster(courseCount);
+
+    std::string students, enrollments, availability;
+    students.reserve(spec.students * 48);
+    std::hash<std::string> hasher;
+    for (std::size_t i = 1; i <= spec.students; ++i) {
+        int id = static_cast<int>(i);
+        std::string first = kFirst[rng.below(kFirst.size())], last = kLast[rng.below(kLast.size())];
+        std::string email = first + "." + last + std::to_string(id) + "@clemson.edu";
+        std::transform(email.begin(), email.end(), email.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+        students += std::to_string(id) + "," + first + " " + last + "," + email + ",";
+        if (rng.below(5) == 0) students += std::to_string(hasher("pass" + std::to_string(id)));
+        students += "\n";
+
+        std::size_t want = 3 + rng.below(4);
+        std::vector<std::size_t> mine;
+        for (std::size_t tries = 0; mine.size() < want && tries < want * 8; ++tries) {
+            std::size_t c = popularity.sample(rng);
+            if (std::find(mine.begin(), mine.end(), c) != mine.end()) continue;
+            mine.push_back(c);
+            roster[c].push_back(id);
+            enrollments += std::to_string(id) + "," + courses[c] + "\n";
+        }
+        stats.enrollments += mine.size();
+
+        // Short blocks, mostly in the daytime, merged into runs per day.
+        std::array<std::array<bool, 24>, 7> hours{};
+        for (std::size_t b = 0, blocks = 1 + rng.below(6); b < blocks; ++b) {
+            std::size_t day = rng.below(7), start = 8 + rng.below(13), len = 1 + rng.below(4);
+            for (std::size_t h = start; h < std::min<std::size_t>(24, start + len); ++h) hours[day][h] = true;
+        }
+        for (int day = 0; day < 7; ++day) {
+            for (int h = 0; h < 24; ) {
+                if (!hours[day][h]) { ++h; continue; }
+                int end = h;
+                while (end < 24 && hours[day][end]) ++end;
+                availability += std::to_string(id) + "," + std::to_string(day) + "," + std::to_string(h) + "," + std::to_string(end) + "\n";
+                ++stats.availability;
+                h = end;
+            }
+        }
+    }
+
+    // Session history drawn from the rosters.
+    std::string sessions, participants;
+    std::size_t sessionCount = spec.students / 4;
+    for (std::size_t n = 0; n < sessionCount * 4 && stats.sessions < sessionCount; ++n) {
+        std::size_t c = popularity.sample(rng);
+        const auto& members = roster[c];
+        if (members.size() < 2) continue;
+        int sid = static_cast<int>(++stats.sessions);
+        int organizer = members[rng.below(members.size())];
+        std::vector<int> group{organizer};
+        for (std::size_t k = 0, invitees = 1 + rng.below(4); k < invitees * 3 && group.size() < invitees + 1; ++k) {
+            int uid = members[rng.below(members.size())];
+            if (std::find(group.begin(), group.end(), uid) == group.end()) group.push_back(uid);
+        }
+        std::size_t roll = rng.below(10);
+        const char* status = roll < 5 ? "CONFIRMED" : roll < 8 ? "PROPOSED" : "CANCELLED";
+        sessions += std::to_string(sid) + "," + courses[c] + "," + std::to_string(rng.below(7)) + ","
+                  + std::to_string(8 + rng.below(13)) + ",1," + std::to_string(organizer) + "," + status
+                  + (roll >= 8 ? ",Conflict\n" : ",\n");
+        for (int uid : group) {
+            bool confirmed = roll < 5 || (roll < 8 && rng.below(2) == 0);
+            participants += std::to_string(sid) + "," + std::to_string(uid) + (confirmed ? ",true\n" : ",false\n");
+        }
+        stats.participants += group.size();
+    }
+
+    return write_file(dir / "students.csv", students)
+        && write_file(dir / "enrollments.csv", enrollments)
+        && write_file(dir / "availability.csv", availability)
+        && write_file(dir / "sessions.csv", sessions)
+        && write_file(dir / "session_participants.csv", participants)
+        && write_file(dir / "journal.log", "");
+}
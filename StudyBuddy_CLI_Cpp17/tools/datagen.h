@@ -0,0 +1,38 @@
+#ifndef STUDY_BUDDY_DATAGEN_H
+#define STUDY_BUDDY_DATAGEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Synthetic data directories for benchmarks. The same spec always produces the same
+// files (the generator carries its own RNG rather than relying on std distributions,
+// whose output differs between standard libraries).
+//
+// Shape of the data:
+//   - about one course per 40 students; enrollment follows a Zipf-like curve, so a few
+//     intro courses hold thousands of students and most hold a few dozen
+//   - 3-6 courses per student
+//   - availability built from 1-6 short blocks per student, merged per day, so slots
+//     are fragmented across the week
+//   - one session per 4 students, drawn from real course rosters: half CONFIRMED,
+//     30% PROPOSED with partial confirmations, 20% CANCELLED
+struct DatasetSpec {
+    std::size_t students{10000};
+    std::uint64_t seed{42};
+};
+
+struct DatasetStats {
+    std::size_t students{0};
+    std::size_t courses{0};
+    std::size_t enrollments{0};
+    std::size_t availability{0};
+    std::size_t sessions{0};
+    std::size_t participants{0};
+};
+
+// Writes the five CSVs and an empty journal.log into `dir` (created if missing; any
+// snapshot.bin there is removed so it cannot shadow the new tables).
+bool generate_dataset(const std::filesystem::path& dir, const DatasetSpec& spec, DatasetStats& stats);
+
+#endif // STUDY_BUDDY_DATAGEN_H
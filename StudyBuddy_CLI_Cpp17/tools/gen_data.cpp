@@ -0,0 +1,31 @@
+// Seeded synthetic data directory for benchmarks and manual load testing:
+//   tools/gen_data --students 100000 [--seed 42] [--out bench_data/100000]
+// Point study_buddy at the result by copying it to data/ (see datagen.h for its shape).
+#include "datagen.h"
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    DatasetSpec spec;
+    std::string out = "bench_data/generated";
+    for (int i = 1; i < argc; i += 2) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) { std::cerr << "Usage: gen_data --students <N> [--seed <S>] [--out <dir>]\n"; return 2; }
+        std::string value = argv[i + 1];
+        try {
+            if (flag == "--students") spec.students = std::stoul(value);
+            else if (flag == "--seed") spec.seed = std::stoull(value);
+            else if (flag == "--out") out = value;
+            else { std::cerr << "Unknown flag " << flag << "\n"; return 2; }
+        } catch (const std::exception&) {
+            std::cerr << "[ERROR] Bad value for " << flag << ": " << value << "\n";
+            return 2;
+        }
+    }
+    DatasetStats stats;
+    if (!generate_dataset(out, spec, stats)) return 1;
+    std::cout << "Wrote " << out << ": " << stats.students << " students, " << stats.courses << " courses, "
+              << stats.enrollments << " enrollments, " << stats.availability << " availability slots, "
+              << stats.sessions << " sessions, " << stats.participants << " participants\n";
+    return 0;
+}